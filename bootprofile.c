@@ -0,0 +1,178 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			bootprofile.c
+ * Module:			Boot time profiler
+ * Purpose:			Timestamps the initialization phases of main.c and the steps
+ *					of disk_initialize (mmc.c) and chk_mounted (ff.c) with
+ *					Timer1, and prints the boot timeline over the USART
+ * -------------------------------------------------------------------------- */
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "bootprofile.h"
+#if __BOOTPROFILE_H != 10
+	#error Error 101 - Version mismatch on header and source code files (bootProfile).
+#endif
+
+#ifdef BOOT_PROFILE
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "globalDefines.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define BOOT_PROFILE_PRESCALER		64
+#define BOOT_PROFILE_CLOCK_SELECT	((1 << CS11) | (1 << CS10))
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct bootMark_t{
+	uint8_t		event;
+	uint8_t		argument;
+	uint16_t	count;				// Consecutive marks merged in this entry
+	uint32_t	ticks;				// Timer1 ticks since the previous entry
+} bootMark_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+static bootMark_t bootMarks[BOOT_PROFILE_ENTRIES];
+static uint8_t bootMarkCount = 0;
+static uint8_t bootMarksLost = 0;
+static uint16_t bootLastTicks = 0;
+static uint8_t bootProfiling = 0;
+
+// -----------------------------------------------------------------------------
+// Private function definitions ------------------------------------------------
+
+static PGM_P bootEventName(uint8_t event)
+{
+	switch(event){
+	case BOOT_EVENT_ADC_INIT:		return PSTR("adc/timer0 init");
+	case BOOT_EVENT_TWI_INIT:		return PSTR("twi init");
+	case BOOT_EVENT_USART_INIT:		return PSTR("usart init");
+	case BOOT_EVENT_BANNER:			return PSTR("banner");
+	case BOOT_EVENT_RTC_CONTROL:	return PSTR("rtc control");
+	case BOOT_EVENT_MOUNT:			return PSTR("f_mount");
+	case BOOT_EVENT_RTC_FORMAT:		return PSTR("rtc format");
+	case BOOT_EVENT_OPEN:			return PSTR("f_open");
+	case BOOT_EVENT_SD_POWER_UP:	return PSTR("  sd power up");
+	case BOOT_EVENT_SD_COMMAND:		return PSTR("  sd cmd");
+	case BOOT_EVENT_SD_CLOCK:		return PSTR("  sd clock");
+	case BOOT_EVENT_SD_READY:		return PSTR("  sd ready");
+	case BOOT_EVENT_FS_DISK_INIT:	return PSTR("  fs disk_initialize");
+	case BOOT_EVENT_FS_BOOT_SECTOR:	return PSTR("  fs boot sector");
+	case BOOT_EVENT_FS_MOUNTED:		return PSTR("  fs mounted");
+	default:						return PSTR("?");
+	}
+}
+
+static uint32_t bootTicksToUs(uint32_t ticks)
+{
+	return ticks * (BOOT_PROFILE_PRESCALER / (F_CPU / 1000000UL));
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	bootProfileStart
+ * Purpose:		Starts Timer1 as the time base of the profiler
+ * Arguments:	none
+ * Returns:		none
+ * Notes:		Must be the first call in main()
+ * -------------------------------------------------------------------------- */
+
+void bootProfileStart(void)
+{
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1 = 0;
+	TCCR1B = BOOT_PROFILE_CLOCK_SELECT;
+	bootLastTicks = 0;
+	bootMarkCount = 0;
+	bootMarksLost = 0;
+	bootProfiling = 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	bootProfileMark
+ * Purpose:		Records the end of a boot step
+ * Arguments:	event		Step that has just finished (bootEvent_t)
+ *				argument	Step detail (SD command index)
+ * Returns:		none
+ * Notes:		Ignored outside the boot window (before bootProfileStart and
+ *				after bootProfileReport)
+ * -------------------------------------------------------------------------- */
+
+void bootProfileMark(bootEvent_t event, uint8_t argument)
+{
+	uint16_t now;
+	uint16_t elapsed;
+	bootMark_t * mark;
+
+	if(!bootProfiling)
+		return;
+	now = TCNT1;
+	elapsed = now - bootLastTicks;
+	bootLastTicks = now;
+
+	if(bootMarkCount){
+		mark = &bootMarks[bootMarkCount - 1];
+		if((mark->event == event) && (mark->argument == argument)){
+			mark->count++;
+			mark->ticks += elapsed;
+			return;
+		}
+	}
+	if(bootMarkCount == BOOT_PROFILE_ENTRIES){
+		bootMarksLost++;
+		bootMarks[BOOT_PROFILE_ENTRIES - 1].ticks += elapsed;
+		return;
+	}
+	mark = &bootMarks[bootMarkCount++];
+	mark->event = event;
+	mark->argument = argument;
+	mark->count = 1;
+	mark->ticks = elapsed;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	bootProfileReport
+ * Purpose:		Ends the boot window, prints the timeline and stops Timer1
+ * Arguments:	none
+ * Returns:		none
+ * Notes:		Uses printf, so the USART must already be bound to stdout
+ * -------------------------------------------------------------------------- */
+
+void bootProfileReport(void)
+{
+	uint32_t total = 0;
+	char name[24];
+	uint8_t i;
+
+	bootProfiling = 0;
+	TCCR1B = 0;
+
+	printf_P(PSTR("Boot profile (us):\n\r"));
+	for(i = 0; i < bootMarkCount; i++){
+		total += bootMarks[i].ticks;
+		strcpy_P(name, bootEventName(bootMarks[i].event));
+		printf_P(PSTR("%10lu +%-9lu %s"), (unsigned long)bootTicksToUs(total), (unsigned long)bootTicksToUs(bootMarks[i].ticks), name);
+		if(bootMarks[i].event == BOOT_EVENT_SD_COMMAND)
+			printf_P(PSTR(" %s%u"), (bootMarks[i].argument & 0x80) ? "ACMD" : "CMD", bootMarks[i].argument & 0x7F);
+		if(bootMarks[i].event == BOOT_EVENT_SD_CLOCK)
+			printf_P(PSTR(" F_CPU/%u"), bootMarks[i].argument);
+		if(bootMarks[i].count > 1)
+			printf_P(PSTR(" x%u"), bootMarks[i].count);
+		printf_P(PSTR("\n\r"));
+	}
+	if(bootMarksLost)
+		printf_P(PSTR("%u marks merged into the last entry\n\r"), bootMarksLost);
+}
+
+#endif
@@ -0,0 +1,66 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			bootprofile.h
+ * Module:			Boot time profiler
+ * Purpose:			Timestamps the initialization phases of main.c and the steps
+ *					of disk_initialize (mmc.c) and chk_mounted (ff.c) with
+ *					Timer1, and prints the boot timeline over the USART
+ * Notes:			Compiled in only when BOOT_PROFILE is defined; otherwise
+ *					every call below expands to nothing. Timer1 runs at F_CPU/64
+ *					during the boot (4 us per tick at 16 MHz). The interval
+ *					between two consecutive marks must stay below one timer
+ *					period (262 ms at 16 MHz); repeated marks of the same step
+ *					(ACMD41 polling) are merged into one line with a count
+ * -------------------------------------------------------------------------- */
+
+#ifndef __BOOTPROFILE_H
+#define __BOOTPROFILE_H 10
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#ifndef BOOT_PROFILE_ENTRIES
+	#define BOOT_PROFILE_ENTRIES		24
+#endif
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef enum bootEvent_t{
+	BOOT_EVENT_ADC_INIT = 0,		// adcEtimer_init
+	BOOT_EVENT_TWI_INIT,			// twiMasterInit
+	BOOT_EVENT_USART_INIT,			// usartConfig, usartEnable*, usartStdio
+	BOOT_EVENT_BANNER,				// First printf
+	BOOT_EVENT_RTC_CONTROL,			// ds1307SetControl (resume counting)
+	BOOT_EVENT_MOUNT,				// f_mount (registers the work area only)
+	BOOT_EVENT_RTC_FORMAT,			// ds1307SetControl (24 hours format)
+	BOOT_EVENT_OPEN,				// f_open (mounts the volume on first access)
+	BOOT_EVENT_SD_POWER_UP,			// disk_initialize: port setup and 80 dummy clocks
+	BOOT_EVENT_SD_COMMAND,			// disk_initialize: one command (argument: command index)
+	BOOT_EVENT_SD_CLOCK,			// disk_initialize: SPI clock negotiated (argument: F_CPU divider)
+	BOOT_EVENT_SD_READY,			// disk_initialize: card type known
+	BOOT_EVENT_FS_DISK_INIT,		// chk_mounted: disk_initialize returned
+	BOOT_EVENT_FS_BOOT_SECTOR,		// chk_mounted: boot sector (and partition table) read
+	BOOT_EVENT_FS_MOUNTED			// chk_mounted: BPB parsed, FSInfo read
+} bootEvent_t;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+#ifdef BOOT_PROFILE
+	void	bootProfileStart(void);
+	void	bootProfileMark(bootEvent_t event, uint8_t argument);
+	void	bootProfileReport(void);
+	#define BOOT_MARK(event, argument)	bootProfileMark((event), (argument))
+#else
+	#define bootProfileStart()
+	#define bootProfileReport()
+	#define BOOT_MARK(event, argument)
+#endif
+
+#endif
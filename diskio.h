@@ -20,6 +20,13 @@ typedef enum {
 	RES_PARERR		/* 4: Invalid Parameter */
 } DRESULT;
 
+/* Results of the non-blocking write (mmc_write_poll) */
+typedef enum {
+	WR_DONE = 0,	/* 0: Idle, the last write is programmed */
+	WR_BUSY,		/* 1: Write in progress */
+	WR_ERROR		/* 2: Last write rejected or timed out */
+} WRSTAT;
+
 
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
@@ -31,6 +38,15 @@ DRESULT disk_read (BYTE, BYTE*, DWORD, BYTE);
 DRESULT disk_write (BYTE, const BYTE*, DWORD, BYTE);
 DRESULT disk_ioctl (BYTE, BYTE, void*);
 
+/* MMC/SDC write session (mmc.c only) */
+DRESULT mmc_write_open (DWORD, DWORD);
+DRESULT mmc_write_sector (const BYTE*);
+DRESULT mmc_write_close (void);
+
+/* MMC/SDC non-blocking write (mmc.c only) */
+DRESULT mmc_write_start (const BYTE*, DWORD);
+WRSTAT mmc_write_poll (void);
+
 
 
 /* Disk Status Bits (DSTATUS) */
@@ -47,5 +63,9 @@ DRESULT disk_ioctl (BYTE, BYTE, void*);
 #define GET_SECTOR_COUNT	1	/* Get media size (for only f_mkfs()) */
 #define GET_SECTOR_SIZE		2	/* Get sector size (for multiple sector size (_MAX_SS >= 1024)) */
 #define GET_BLOCK_SIZE		3	/* Get erase block size (for only f_mkfs()) */
+#define CTRL_ERASE_SECTOR	4	/* Force erased a block of sectors (for only _USE_ERASE) */
+
+/* MMC/SDC specific command */
+#define MMC_GET_ERASE_INFO	15	/* Get AU size (sectors), erase size (AUs), erase timeout and offset (s) (DWORD[4]) */
 
 #endif
@@ -94,6 +94,7 @@
 
 #include "ff.h"			// FatFs configurations and declarations 
 #include "diskio.h"		// Declarations of low level disk I/O functions 
+#include "bootprofile.h"	// Boot timeline marks (empty unless BOOT_PROFILE) 
 
 
 //--------------------------------------------------------------------------
@@ -711,6 +712,32 @@ void clear_lock (	// Clear lock entries of the volume //
 
 
 
+//-----------------------------------------------------------------------//
+// Deferred FAT copies - Queue a FAT sector                              //
+//-----------------------------------------------------------------------//
+#if !_FS_READONLY && _FS_LAZY_MIRROR
+static
+BYTE mirror_queue (	// 1:Queued, 0:Queue is full //
+	FATFS *fs,		// File system object //
+	DWORD ofs		// FAT sector offset from fatbase //
+)
+{
+	BYTE i;
+
+
+	for (i = 0; i < fs->n_mirror; i++) {
+		if (fs->mirror[i] == ofs) return 1;	// Already queued //
+	}
+	if (i >= _FS_LAZY_MIRROR) return 0;
+	fs->mirror[i] = ofs;
+	fs->n_mirror = i + 1;
+	return 1;
+}
+#endif
+
+
+
+
 //-----------------------------------------------------------------------//
 // Change window offset                                                  //
 //-----------------------------------------------------------------------//
@@ -732,8 +759,12 @@ FRESULT move_window (
 				return FR_DISK_ERR;
 			fs->wflag = 0;
 			if (wsect < (fs->fatbase + fs->fsize)) {	// In FAT area //
-				BYTE nf;
-				for (nf = fs->n_fats; nf > 1; nf--) {	// Reflect the change to all FAT copies //
+				BYTE nf = fs->n_fats;
+#if _FS_LAZY_MIRROR
+				if (nf > 1 && wsect >= fs->fatbase && mirror_queue(fs, wsect - fs->fatbase))
+					nf = 1;							// The copies are written by sync() //
+#endif
+				for ( ; nf > 1; nf--) {	// Reflect the change to all FAT copies //
 					wsect += fs->fsize;
 					disk_write(fs->drv, fs->win, wsect, 1);
 				}
@@ -753,6 +784,39 @@ FRESULT move_window (
 
 
 
+//-----------------------------------------------------------------------//
+// Deferred FAT copies - Write the queued sectors to the FAT copies      //
+//-----------------------------------------------------------------------//
+#if !_FS_READONLY && _FS_LAZY_MIRROR
+static
+FRESULT mirror_flush (	// FR_OK: successful, FR_DISK_ERR: failed //
+	FATFS *fs	// File system object (the window must be clean) //
+)
+{
+	DWORD sect;
+	BYTE i, nf;
+
+
+	while (fs->n_mirror) {
+		for (i = 0; i < fs->n_mirror - 1; i++) {	// The sector in the window saves a read //
+			if (fs->fatbase + fs->mirror[i] == fs->winsect) break;
+		}
+		sect = fs->fatbase + fs->mirror[i];
+		if (move_window(fs, sect) != FR_OK) return FR_DISK_ERR;	// Read it from the first FAT //
+		for (nf = fs->n_fats; nf > 1; nf--) {
+			sect += fs->fsize;
+			if (disk_write(fs->drv, fs->win, sect, 1) != RES_OK) return FR_DISK_ERR;
+		}
+		fs->mirror[i] = fs->mirror[--fs->n_mirror];	// Dequeue //
+	}
+
+	return FR_OK;
+}
+#endif
+
+
+
+
 //-----------------------------------------------------------------------//
 // Clean-up cached data                                                  //
 //-----------------------------------------------------------------------//
@@ -766,6 +830,9 @@ FRESULT sync (	// FR_OK: successful, FR_DISK_ERR: failed //
 
 
 	res = move_window(fs, 0);
+#if _FS_LAZY_MIRROR
+	if (res == FR_OK) res = mirror_flush(fs);	// Bring the FAT copies up to date //
+#endif
 	if (res == FR_OK) {
 		// Update FSInfo sector if needed //
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag) {
@@ -854,6 +921,46 @@ DWORD get_fat (	// 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster status
 
 
 
+//-----------------------------------------------------------------------//
+// FAT access - Free cluster map                                         //
+//-----------------------------------------------------------------------//
+#if !_FS_READONLY && _FS_FREEMAP
+
+static
+void fm_mark (
+	FATFS *fs,	// File system object //
+	DWORD clst,	// Cluster# in the group //
+	BYTE fre	// 0:No free cluster in the group, 1:The group may have free clusters //
+)
+{
+	DWORD grp = clst / fs->fm_ncl;
+
+
+	if (fre)
+		fs->freemap[grp / 8] |= 1 << (grp % 8);
+	else
+		fs->freemap[grp / 8] &= ~(1 << (grp % 8));
+}
+
+
+static
+DWORD fm_skip (	// 0:The group may have free clusters, Else:Last cluster# of the full group //
+	FATFS *fs,	// File system object //
+	DWORD clst	// Cluster# in the group //
+)
+{
+	DWORD grp = clst / fs->fm_ncl;
+
+
+	if (fs->freemap[grp / 8] & (1 << (grp % 8))) return 0;
+	clst = (grp + 1) * fs->fm_ncl - 1;
+	return (clst < fs->n_fatent) ? clst : fs->n_fatent - 1;
+}
+#endif // !_FS_READONLY && _FS_FREEMAP //
+
+
+
+
 //-----------------------------------------------------------------------//
 // FAT access - Change value of a FAT entry                              //
 //-----------------------------------------------------------------------//
@@ -908,6 +1015,9 @@ FRESULT put_fat (
 			res = FR_INT_ERR;
 		}
 		fs->wflag = 1;
+#if _FS_FREEMAP
+		if (res == FR_OK && val == 0) fm_mark(fs, clst, 1);	// The group has a free cluster again //
+#endif
 	}
 
 	return res;
@@ -982,6 +1092,9 @@ DWORD create_chain (	// 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 {
 	DWORD cs, ncl, scl;
 	FRESULT res;
+#if _FS_FREEMAP
+	DWORD gcl, ecl;
+#endif
 
 
 	if (clst == 0) {		// Create a new chain //
@@ -996,12 +1109,30 @@ DWORD create_chain (	// 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 	}
 
 	ncl = scl;				// Start cluster //
+#if _FS_FREEMAP
+	gcl = 0;				// Top of the group scanned from its top (0:None) //
+#endif
 	for (;;) {
 		ncl++;							// Next cluster //
+#if _FS_FREEMAP
+		if (gcl && (ncl >= fs->n_fatent || ncl % fs->fm_ncl == 0))
+			fm_mark(fs, gcl, 0);		// Scanned the whole group without a free cluster //
+#endif
 		if (ncl >= fs->n_fatent) {		// Wrap around //
 			ncl = 2;
 			if (ncl > scl) return 0;	// No free cluster //
 		}
+#if _FS_FREEMAP
+		if (ncl == 2 || ncl % fs->fm_ncl == 0) {	// Top of a group //
+			gcl = ncl;
+			ecl = fm_skip(fs, ncl);
+			if (ecl) {					// Known to be full: skip the group //
+				if (scl >= ncl && scl <= ecl) return 0;	// No free cluster //
+				ncl = ecl; gcl = 0;
+				continue;
+			}
+		}
+#endif
 		cs = get_fat(fs, ncl);			// Get the cluster status //
 		if (cs == 0) break;				// Found a free cluster //
 		if (cs == 0xFFFFFFFF || cs == 1)// An error occurred //
@@ -1053,6 +1184,51 @@ DWORD clmt_clust (	// <2:Error, >=2:Cluster number //
 	}
 	return cl + *tbl;	// Return the cluster number //
 }
+
+
+#if !_FS_READONLY
+static
+void clmt_append (
+	FIL* fp,		// Pointer to the file object //
+	DWORD clst,		// First cluster added to the end of the chain //
+	DWORD ncl		// Number of contiguous clusters added //
+)
+{
+	DWORD ulen, *tbl;
+
+
+	tbl = fp->cltbl;
+	if (!tbl) return;
+	ulen = *tbl;			// Number of items used (the last one is the terminator) //
+	if (ulen > 2 && tbl[ulen - 2] + tbl[ulen - 3] == clst) {	// Stretch the last fragment //
+		tbl[ulen - 3] += ncl;
+	} else if (ulen + 2 <= fp->cltlen) {	// Add a fragment //
+		tbl[ulen - 1] = ncl; tbl[ulen] = clst;
+		tbl[ulen + 1] = 0;
+		*tbl = ulen + 2;
+	} else {				// Table is full: back to normal seek mode //
+		fp->cltbl = 0;
+	}
+}
+
+
+static
+DWORD clmt_chain (	// 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Cluster number //
+	FIL* fp			// Pointer to the file object //
+)
+{
+	DWORD clst;
+
+
+	clst = clmt_clust(fp, fp->fptr);	// Get cluster# from the CLMT //
+	if (!clst) {						// Beyond the end of the chain //
+		clst = create_chain(fp->fs, fp->clust);	// Stretch the chain and the CLMT //
+		if (clst >= 2 && clst < fp->fs->n_fatent)
+			clmt_append(fp, clst, 1);
+	}
+	return clst;
+}
+#endif
 #endif	// _USE_FASTSEEK //
 
 
@@ -2054,6 +2230,7 @@ FRESULT chk_mounted (	// FR_OK(0): successful, !=0: any error occurred //
 	fs->fs_type = 0;					// Clear the file system object //
 	fs->drv = LD2PD(vol);				// Bind the logical drive and a physical drive //
 	stat = disk_initialize(fs->drv);	// Initialize low level disk I/O layer //
+	BOOT_MARK(BOOT_EVENT_FS_DISK_INIT, stat);
 	if (stat & STA_NOINIT)				// Check if the initialization succeeded //
 		return FR_NOT_READY;			// Failed to initialize due to no media or hard error //
 	if (!_FS_READONLY && chk_wp && (stat & STA_PROTECT))	// Check disk write protection if needed //
@@ -2075,6 +2252,7 @@ FRESULT chk_mounted (	// FR_OK(0): successful, !=0: any error occurred //
 			fmt = check_fs(fs, bsect);		// Check the partition //
 		}
 	}
+	BOOT_MARK(BOOT_EVENT_FS_BOOT_SECTOR, fmt);
 	if (fmt == 3) return FR_DISK_ERR;
 	if (fmt) return FR_NO_FILESYSTEM;		// No FAT volume is found //
 
@@ -2133,6 +2311,13 @@ FRESULT chk_mounted (	// FR_OK(0): successful, !=0: any error occurred //
 	// Initialize cluster allocation information //
 	fs->free_clust = 0xFFFFFFFF;
 	fs->last_clust = 0;
+#if _FS_LAZY_MIRROR
+	fs->n_mirror = 0;
+#endif
+#if _FS_FREEMAP
+	fs->fm_ncl = ((fs->n_fatent - 1) / (_FS_FREEMAP * 8) / 128 + 1) * 128;	// Whole 128 entries per bit (FAT32 sector) //
+	mem_set(fs->freemap, 0xFF, _FS_FREEMAP);	// Any group may have free clusters //
+#endif
 
 	// Get fsinfo if available //
 	if (fmt == FS_FAT32) {
@@ -2149,6 +2334,7 @@ FRESULT chk_mounted (	// FR_OK(0): successful, !=0: any error occurred //
 #endif
 	fs->fs_type = fmt;		// FAT sub-type //
 	fs->id = ++Fsid;		// File system mount ID //
+	BOOT_MARK(BOOT_EVENT_FS_MOUNTED, fmt);
 	fs->winsect = 0;		// Invalidate sector cache //
 	fs->wflag = 0;
 #if _FS_RPATH
@@ -2355,6 +2541,9 @@ FRESULT f_open (
 		fp->dsect = 0;
 #if _USE_FASTSEEK
 		fp->cltbl = 0;						// Normal seek mode //
+#endif
+#if _USE_PREALLOC && !_FS_READONLY
+		fp->pa_start = fp->pa_end = 0;		// No reserved run //
 #endif
 		fp->fs = dj.fs; fp->id = dj.fs->id;	// Validate file object //
 	}
@@ -2501,12 +2690,22 @@ FRESULT f_write (
 			if (!csect) {					// On the cluster boundary? 
 				if (fp->fptr == 0) {		// On the top of the file? 
 					clst = fp->sclust;		// Follow from the origin 
-					if (clst == 0)			// When no cluster is allocated, 
+					if (clst == 0) {		// When no cluster is allocated, 
 						fp->sclust = clst = create_chain(fp->fs, 0);	// Create a new cluster chain 
+#if _USE_FASTSEEK
+						if (clst >= 2 && clst < fp->fs->n_fatent)
+							clmt_append(fp, clst, 1);	// First fragment of the CLMT 
+#endif
+					}
 				} else {					// Middle or end of the file 
+#if _USE_PREALLOC
+					if (fp->clust >= fp->pa_start && fp->clust < fp->pa_end)
+						clst = fp->clust + 1;	// Next cluster of the reserved run, no FAT access 
+					else
+#endif
 #if _USE_FASTSEEK
 					if (fp->cltbl)
-						clst = clmt_clust(fp, fp->fptr);	// Get cluster# from the CLMT 
+						clst = clmt_chain(fp);	// Get cluster# from the CLMT, stretch both if needed 
 					else
 #endif
 						clst = create_chain(fp->fs, fp->clust);	// Follow or stretch cluster chain on the FAT 
@@ -2632,6 +2831,188 @@ FRESULT f_sync (
 
 
 
+#if _USE_PREALLOC && !_FS_READONLY
+//-----------------------------------------------------------------------
+// Reserve a Contiguous Cluster Chain for the File                       
+//-----------------------------------------------------------------------
+
+FRESULT f_prealloc (
+	FIL *fp,		// Pointer to the file object 
+	DWORD fsz		// File size the cluster chain has to cover 
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD bcs, clst, rcl, ncl, scl, ecl, stat, n;
+
+
+	res = validate(fp->fs, fp->id);		// Check validity of the object 
+	if (res == FR_OK) {
+		if (fp->flag & FA__ERROR) {			// Check abort flag 
+			res = FR_INT_ERR;
+		} else {
+			if (!(fp->flag & FA_WRITE))		// Check access mode 
+				res = FR_DENIED;
+		}
+	}
+	if (res == FR_OK) {
+		fs = fp->fs;
+		bcs = (DWORD)fs->csize * SS(fs);	// Cluster size [byte] 
+		ncl = fsz / bcs + (fsz % bcs ? 1 : 0);	// Number of clusters to cover fsz 
+		if (fp->fptr) {						// Follow the chain from the current cluster 
+			clst = fp->clust;
+			n = (fp->fptr - 1) / bcs + 1;
+		} else {							// Follow the chain from the top of the file 
+			clst = fp->sclust;
+			n = clst ? 1 : 0;
+		}
+		rcl = clst;							// Top of the contiguous run ending at clst 
+		while (clst && n < ncl) {			// Find the last cluster of the chain 
+			stat = get_fat(fs, clst);
+			if (stat == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+			if (stat < 2) ABORT(fs, FR_INT_ERR);
+			if (stat >= fs->n_fatent) break;	// Last link 
+			if (stat != clst + 1) rcl = stat;
+			clst = stat; n++;
+		}
+		ncl = (n < ncl) ? ncl - n : 0;		// Number of clusters to be added 
+		ecl = clst;
+		if (ncl) {							// Find ncl contiguous free clusters 
+			scl = clst ? clst : fs->last_clust;	// Right after the chain or where create_chain() would look 
+			if (!scl || scl >= fs->n_fatent) scl = 1;
+			ecl = scl; n = 0;				// n: free clusters up to ecl 
+			for (;;) {
+				ecl++;
+				if (ecl >= fs->n_fatent) {	// Wrap around, a run does not straddle the end 
+					ecl = 2; n = 0;
+					if (ecl > scl) LEAVE_FF(fs, FR_DENIED);	// No free run long enough 
+				}
+#if _FS_FREEMAP
+				if (ecl == 2 || ecl % fs->fm_ncl == 0) {	// Top of a group 
+					stat = fm_skip(fs, ecl);
+					if (stat) {				// Known to be full: skip the group 
+						if (scl >= ecl && scl <= stat) LEAVE_FF(fs, FR_DENIED);	// No free run long enough 
+						ecl = stat; n = 0;
+						continue;
+					}
+				}
+#endif
+				stat = get_fat(fs, ecl);
+				if (stat == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+				if (stat == 1) ABORT(fs, FR_INT_ERR);
+				if (stat == 0) {
+					if (++n == ncl) break;	// Found the run 
+				} else {
+					n = 0;
+				}
+				if (ecl == scl) LEAVE_FF(fs, FR_DENIED);	// No free run long enough 
+			}
+			scl = ecl - ncl + 1;			// Top of the new run 
+			for (n = scl; n < ecl && res == FR_OK; n++)
+				res = put_fat(fs, n, n + 1);	// Link the run 
+			if (res == FR_OK)
+				res = put_fat(fs, ecl, 0x0FFFFFFF);	// Mark the last cluster "last link" 
+			if (res == FR_OK) {
+				if (clst) {
+					res = put_fat(fs, clst, scl);	// Link it to the chain 
+				} else {
+					fp->sclust = scl;		// New chain: the start cluster goes to the directory entry on f_sync() 
+					fp->flag |= FA__WRITTEN;
+				}
+			}
+			if (res != FR_OK) ABORT(fs, res);
+#if _USE_FASTSEEK
+			clmt_append(fp, scl, ncl);		// Keep the CLMT in step with the chain 
+#endif
+			fs->last_clust = ecl;			// Update FSINFO 
+			if (fs->free_clust != 0xFFFFFFFF) {
+				fs->free_clust -= ncl;
+				fs->fsi_flag = 1;
+			}
+			if (scl != clst + 1) rcl = scl;
+		}
+		fp->pa_start = rcl;					// f_write() follows the run without reading the FAT 
+		fp->pa_end = ecl;
+	}
+
+	LEAVE_FF(fp->fs, res);
+}
+#endif
+
+
+
+
+#if _USE_ERASE && !_FS_READONLY
+//-----------------------------------------------------------------------
+// Pre-erase the Free Clusters the File will Grow into                   
+//-----------------------------------------------------------------------
+
+FRESULT f_preerase (
+	FIL *fp,		// Pointer to the file object 
+	DWORD ncl		// Number of clusters to scan after the current cluster 
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD clst, scl, ecl, stat, resion[2];
+#if _USE_PREALLOC
+	DWORD pcl;
+#endif
+
+
+	res = validate(fp->fs, fp->id);		// Check validity of the object 
+	if (res == FR_OK) {
+		if (fp->flag & FA__ERROR) {			// Check abort flag 
+			res = FR_INT_ERR;
+		} else {
+			if (!(fp->flag & FA_WRITE))		// Check access mode 
+				res = FR_DENIED;
+		}
+	}
+	if (res == FR_OK) {
+		fs = fp->fs;
+		clst = fp->fptr ? fp->clust : fs->last_clust;	// create_chain() looks for free clusters from here 
+#if _USE_PREALLOC
+		pcl = 0;								// Reserved clusters after the current one are empty at the end of the file 
+		if (fp->pa_start && fp->fptr == fp->fsize) {
+			if (!fp->fptr && fp->sclust == fp->pa_start) {
+				clst = fp->pa_start - 1;		// The whole reserved run is still empty 
+				pcl = fp->pa_end;
+			}
+			if (fp->fptr && clst >= fp->pa_start && clst <= fp->pa_end)
+				pcl = fp->pa_end;
+		}
+#endif
+		if (!clst || clst >= fs->n_fatent) clst = 1;
+		scl = ecl = 0;
+		while (ncl-- && ++clst < fs->n_fatent) {
+			stat = get_fat(fs, clst);			// Get the cluster status 
+			if (stat == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+#if _USE_PREALLOC
+			if (clst <= pcl) stat = 0;			// Erase it as a free cluster 
+#endif
+			if (stat == 0) {					// Free cluster: stretch the run 
+				if (!scl) scl = clst;
+				ecl = clst;
+			}
+			if (scl && (stat != 0 || !ncl || clst + 1 >= fs->n_fatent)) {	// End of a run of free clusters 
+				resion[0] = clust2sect(fs, scl);					// Start sector 
+				resion[1] = clust2sect(fs, ecl) + fs->csize - 1;	// End sector 
+				if (disk_ioctl(fs->drv, CTRL_ERASE_SECTOR, resion) != RES_OK) {	// Erase the block 
+					res = FR_DISK_ERR; break;
+				}
+				scl = 0;
+			}
+		}
+	}
+
+	LEAVE_FF(fp->fs, res);
+}
+#endif
+
+
+
+
 //-----------------------------------------------------------------------//
 // Close File                                                            //
 //-----------------------------------------------------------------------//
@@ -2820,6 +3201,7 @@ FRESULT f_lseek (
 		if (ofs == CREATE_LINKMAP) {	// Create CLMT //
 			tbl = fp->cltbl;
 			tlen = *tbl++; ulen = 2;	// Given table size and required table size //
+			fp->cltlen = tlen;
 			cl = fp->sclust;			// Top of the chain //
 			if (cl) {
 				do {
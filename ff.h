@@ -92,6 +92,14 @@ typedef struct {
 	DWORD	last_clust;		/* Last allocated cluster */
 	DWORD	free_clust;		/* Number of free clusters */
 	DWORD	fsi_sector;		/* fsinfo sector (FAT32) */
+#if _FS_LAZY_MIRROR
+	BYTE	n_mirror;		/* Number of FAT sectors queued for the FAT copies */
+	DWORD	mirror[_FS_LAZY_MIRROR];	/* Queued FAT sectors (offset from fatbase) */
+#endif
+#if _FS_FREEMAP
+	DWORD	fm_ncl;			/* Clusters per bit of the free cluster map */
+	BYTE	freemap[_FS_FREEMAP];	/* Free cluster map (0:Group has no free cluster) */
+#endif
 #endif
 #if _FS_RPATH
 	DWORD	cdir;			/* Current directory start cluster (0:root) */
@@ -125,6 +133,11 @@ typedef struct {
 #endif
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (null on file open) */
+	DWORD	cltlen;			/* Size of the cluster link map table given on CREATE_LINKMAP */
+#endif
+#if _USE_PREALLOC && !_FS_READONLY
+	DWORD	pa_start;		/* First cluster of the contiguous run reserved by f_prealloc (0 on file open) */
+	DWORD	pa_end;			/* Last cluster of that run */
 #endif
 #if _FS_SHARE
 	UINT	lockid;			/* File lock ID (index of file semaphore table) */
@@ -213,6 +226,8 @@ FRESULT f_write (FIL*, const void*, UINT, UINT*);	/* Write data to a file */
 FRESULT f_getfree (const TCHAR*, DWORD*, FATFS**);	/* Get number of free clusters on the drive */
 FRESULT f_truncate (FIL*);							/* Truncate file */
 FRESULT f_sync (FIL*);								/* Flush cached data of a writing file */
+FRESULT f_preerase (FIL*, DWORD);					/* Erase the free clusters a file will grow into */
+FRESULT f_prealloc (FIL*, DWORD);					/* Reserve a contiguous cluster chain for a file */
 FRESULT f_unlink (const TCHAR*);					/* Delete an existing file or directory */
 FRESULT	f_mkdir (const TCHAR*);						/* Create a new directory */
 FRESULT f_chmod (const TCHAR*, BYTE, BYTE);			/* Change attriburte of the file/dir */
@@ -48,8 +48,30 @@
 /* To enable f_forward function, set _USE_FORWARD to 1 and set _FS_TINY to 1. */
 
 
-#define	_USE_FASTSEEK	0	/* 0:Disable or 1:Enable */
-/* To enable fast seek feature, set _USE_FASTSEEK to 1. */
+#define	_USE_FASTSEEK	1	/* 0:Disable or 1:Enable */
+/* To enable fast seek feature, set _USE_FASTSEEK to 1. f_write() keeps the
+/  cluster link map table in step with the cluster chain as the file grows. */
+
+
+#define	_USE_PREALLOC	1	/* 0:Disable or 1:Enable */
+/* To enable f_prealloc function, set _USE_PREALLOC to 1 and set _FS_READONLY to 0.
+/  f_write() follows the contiguous run reserved by f_prealloc() without
+/  reading the FAT. */
+
+
+#define	_FS_LAZY_MIRROR	4	/* 0:Disable or number of FAT sectors whose copies can be deferred */
+/* When a dirty FAT sector leaves the window only the first FAT is written and the
+/  sector is queued; sync() writes the other FAT copies of the queued sectors in
+/  one batch, i.e. on f_sync() and f_close(). A sector already queued is not
+/  queued again, and with the queue full the copies are written at once. Until
+/  the next sync the other FAT copies lag behind the first one. */
+
+
+#define	_FS_FREEMAP	32	/* 0:Disable or size of the free cluster map in bytes */
+/* The free cluster map keeps one bit per group of clusters. The bit is cleared
+/  when an allocation scan finds no free cluster in the whole group, and set again
+/  when a cluster of the group is freed. create_chain() and f_prealloc() skip the
+/  groups known to be full. */
 
 
 
@@ -143,7 +165,7 @@
 / is tied to the partitions listed in VolToPart[]. */
 
 
-#define	_USE_ERASE	0	/* 0:Disable or 1:Enable */
+#define	_USE_ERASE	1	/* 0:Disable or 1:Enable */
 /* To enable sector erase feature, set _USE_ERASE to 1. CTRL_ERASE_SECTOR command
 /  should be added to the disk_ioctl functio. */
 
@@ -182,7 +204,11 @@
 /      function must be added to the project. */
 
 
+#if defined(RAM_USAGE) || defined(MMC_STATS)
+#define	_FS_SHARE	2	/* Radiacao.csv and a report file (ramusage.c, mmcstats.c) */
+#else
 #define	_FS_SHARE	1	/* 0:Disable or >=1:Enable */
+#endif
 /* To enable file shareing feature, set _FS_SHARE to 1 or greater. The value
    defines how many files can be opened simultaneously. */
 
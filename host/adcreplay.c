@@ -0,0 +1,234 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			adcreplay.c
+ * Module:			ADC trace replay
+ * Purpose:			Supplies the conversion results of the emulated ADC, so the
+ *					acquisition code in sensor.c (ISR(ADC_vect), running sums)
+ *					and the logging path can be fed with recorded irradiance
+ *					data and run at full host speed
+ * Notes:			Linking this module attaches it to the ADC. The data source
+ *					is selected with environment variables:
+ *					ADC_TRACE			trace file; without it a synthetic
+ *										clear-sky day is generated
+ *					ADC_TRACE_FORMAT	"csv" (default) or "bin"
+ *					ADC_TRACE_CHANNELS	channels per row of a binary trace
+ *										(default 2)
+ *					ADC_TRACE_PERIOD_US	virtual time covered by one row; 0
+ *										(default) consumes one row per round of
+ *										conversions over the channels
+ *					ADC_TRACE_LOOP		rewind at the end instead of ending
+ *										the run
+ *					ADC_SYNTH_PEAK		synthetic irradiance peak (default 800)
+ *					ADC_SYNTH_START_S	synthetic time of day at start, in
+ *										seconds (default 56100, 15:35)
+ *					ADC_STATS			print conversion and replay counters
+ *										at exit
+ *					CSV rows hold one value per channel, ADC0 first, separated
+ *					by commas, semicolons or blanks; lines that do not start
+ *					with a number are skipped. Binary rows are little-endian
+ *					16-bit values
+ * -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "hostio.h"
+#include "hostclock.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define REPLAY_MAX_CHANNELS		8
+#define REPLAY_LINE_SIZE		256
+#define REPLAY_DAY_SECONDS		86400UL
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct replayStats_t{
+	uint64_t	rows;				// Trace rows consumed
+	uint64_t	samples;			// Values handed to the ADC
+	uint32_t	rewinds;
+} replayStats_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+static FILE * trace = 0;
+static uint8_t binary = 0;
+static uint8_t loop = 0;
+static uint32_t channels = 2;
+static uint64_t periodCycles = 0;
+static uint64_t rowEnd = 0;				// Virtual clock cycle where the current row expires
+static uint16_t row[REPLAY_MAX_CHANNELS];
+static uint8_t rowValid = 0;
+static uint8_t consumed = 0;			// Channels already converted from the current row
+static uint32_t synthPeak = 800;
+static uint32_t synthStart = 56100;
+static uint32_t noise = 1;
+static replayStats_t replayStats;
+
+// -----------------------------------------------------------------------------
+// Trace reader ----------------------------------------------------------------
+
+static uint8_t readCsvRow(void)
+{
+	char line[REPLAY_LINE_SIZE];
+	char * p;
+	char * end;
+	uint8_t i;
+	long value;
+
+	while(fgets(line, sizeof(line), trace)){
+		p = line;
+		while(isspace((unsigned char)*p))
+			p++;
+		if(!isdigit((unsigned char)*p))
+			continue;					// Header, comment or blank line
+		memset(row, 0, sizeof(row));
+		for(i = 0; i < REPLAY_MAX_CHANNELS; i++){
+			value = strtol(p, &end, 10);
+			if(end == p)
+				break;
+			row[i] = (value < 0) ? 0 : (uint16_t)value;
+			p = end + strspn(end, ",; \t");
+		}
+		return 1;
+	}
+	return 0;
+}
+
+static uint8_t readBinaryRow(void)
+{
+	uint8_t raw[2 * REPLAY_MAX_CHANNELS];
+	uint8_t i;
+
+	if(fread(raw, 2, channels, trace) != channels)
+		return 0;
+	for(i = 0; i < channels; i++)
+		row[i] = raw[2 * i] | (raw[2 * i + 1] << 8);
+	return 1;
+}
+
+/* Loads the next row, rewinding or ending the run at the end of the trace */
+static void nextRow(void)
+{
+	uint8_t ok = binary ? readBinaryRow() : readCsvRow();
+
+	if(!ok && loop && (replayStats.rows || rowValid)){
+		rewind(trace);
+		replayStats.rewinds++;
+		ok = binary ? readBinaryRow() : readCsvRow();
+	}
+	if(!ok){
+		fprintf(stderr, "adcreplay: end of trace after %llu rows\n", (unsigned long long)replayStats.rows);
+		exit(EXIT_SUCCESS);
+	}
+	rowValid = 1;
+	replayStats.rows++;
+}
+
+static uint16_t traceSample(uint8_t channel)
+{
+	uint64_t now = hostClockCycles();
+
+	if(periodCycles){
+		if(!rowValid){
+			nextRow();
+			rowEnd = now + periodCycles;
+		}
+		while(now >= rowEnd){			// Skip the rows the clock went past
+			nextRow();
+			rowEnd += periodCycles;
+		}
+	}else if(!rowValid || (consumed & (1 << channel))){
+		nextRow();
+		consumed = 0;
+	}
+	consumed |= (1 << channel);
+	return (channel < REPLAY_MAX_CHANNELS) ? row[channel] : 0;
+}
+
+// -----------------------------------------------------------------------------
+// Synthetic source ------------------------------------------------------------
+
+/* Clear-sky day on ADC0 (sunrise 06:00, sunset 18:00) and a hall sensor at
+ * mid-scale plus a load proportional to it on ADC1, with a few LSB of noise */
+static uint16_t synthSample(uint8_t channel)
+{
+	double seconds = (double)hostClockCycles() / F_CPU + synthStart;
+	double phase = fmod(seconds, REPLAY_DAY_SECONDS) / REPLAY_DAY_SECONDS;
+	double sun = sin(2.0 * M_PI * (phase - 0.25));
+	int32_t irradiance = (sun > 0) ? (int32_t)(synthPeak * sun) : 0;
+	int32_t value;
+
+	noise = noise * 1103515245UL + 12345;
+	value = (int32_t)((noise >> 16) & 0x07) - 3;
+	switch(channel){
+	case 0:
+		value += irradiance;
+		break;
+	case 1:
+		value += 512 + irradiance / 8;
+		break;
+	default:
+		return 0;
+	}
+	if(value < 0)
+		value = 0;
+	return (value > 0x3FF) ? 0x3FF : (uint16_t)value;
+}
+
+static uint16_t replaySample(uint8_t channel)
+{
+	replayStats.samples++;
+	return trace ? traceSample(channel) : synthSample(channel);
+}
+
+// -----------------------------------------------------------------------------
+// Initialization --------------------------------------------------------------
+
+static void replayFinish(void)
+{
+	if(trace)
+		fclose(trace);
+	if(!getenv("ADC_STATS"))
+		return;
+	fprintf(stderr, "adc: %llu timer0 overflows, %llu conversions, %llu missed triggers\n",
+		(unsigned long long)hostAdcStats.timer0Overflows, (unsigned long long)hostAdcStats.conversions,
+		(unsigned long long)hostAdcStats.missedTriggers);
+	fprintf(stderr, "adcreplay: %s, %llu samples, %llu rows, %u rewinds\n", trace ? "trace" : "synthetic",
+		(unsigned long long)replayStats.samples, (unsigned long long)replayStats.rows, replayStats.rewinds);
+}
+
+__attribute__((constructor)) static void adcReplayInsert(void)
+{
+	const char * path = getenv("ADC_TRACE");
+	const char * env;
+
+	if((env = getenv("ADC_SYNTH_PEAK")))
+		synthPeak = (uint32_t)strtoul(env, NULL, 0);
+	if((env = getenv("ADC_SYNTH_START_S")))
+		synthStart = (uint32_t)strtoul(env, NULL, 0);
+	if(path){
+		if((env = getenv("ADC_TRACE_FORMAT")))
+			binary = !strcmp(env, "bin");
+		if((env = getenv("ADC_TRACE_CHANNELS")))
+			channels = (uint32_t)strtoul(env, NULL, 0);
+		if((channels < 1) || (channels > REPLAY_MAX_CHANNELS))
+			channels = 2;
+		if((env = getenv("ADC_TRACE_PERIOD_US")))
+			periodCycles = (uint64_t)strtoull(env, NULL, 0) * HOST_CYCLES_PER_US;
+		loop = getenv("ADC_TRACE_LOOP") ? 1 : 0;
+		trace = fopen(path, binary ? "rb" : "r");
+		if(!trace){
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	hostAdcAttach(replaySample);
+	atexit(replayFinish);
+}
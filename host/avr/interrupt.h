@@ -0,0 +1,40 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			avr/interrupt.h
+ * Module:			Interrupt shim for the host (PC) build
+ * Purpose:			ISR() becomes a plain function named after the vector, so the
+ *					host peripheral models can call it. sei()/cli() drive the I
+ *					bit of the emulated SREG
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOST_AVR_INTERRUPT_H
+#define __HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+// -----------------------------------------------------------------------------
+// Interrupt vectors used by the firmware --------------------------------------
+
+void INT0_vect(void);
+void TIMER0_OVF_vect(void);
+void TIMER1_OVF_vect(void);
+void TIMER2_OVF_vect(void);
+void SPI_STC_vect(void);
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+void USART_TX_vect(void);
+void ADC_vect(void);
+void TWI_vect(void);
+
+#define ISR(vector, ...)	void vector(void)
+
+// -----------------------------------------------------------------------------
+// Global interrupt flag -------------------------------------------------------
+
+void hostInterruptsEnable(void);
+
+#define sei()	hostInterruptsEnable()
+#define cli()	(SREG &= ~(1 << SREG_I))
+#define reti()	return
+
+#endif
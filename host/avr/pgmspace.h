@@ -0,0 +1,29 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			avr/pgmspace.h
+ * Module:			Program space shim for the host (PC) build
+ * Purpose:			The host has a single address space, so flash accessors read
+ *					plain memory
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOST_AVR_PGMSPACE_H
+#define __HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PGM_P					const char *
+#define PSTR(s)					(s)
+#define pgm_read_byte(addr)		(*(const uint8_t *)(addr))
+#define pgm_read_word(addr)		(*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)	(*(const uint32_t *)(addr))
+#define strlen_P				strlen
+#define strcpy_P				strcpy
+#define memcpy_P				memcpy
+#define printf_P				printf
+#define sprintf_P				sprintf
+#define snprintf_P				snprintf
+
+#endif
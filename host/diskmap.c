@@ -0,0 +1,382 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			diskmap.c
+ * Module:			Sector write accounting
+ * Purpose:			Tags every sector written to the media as boot, FSInfo,
+ *					FAT, FAT mirror, directory or data, keeps a write count per
+ *					sector and relates the bytes written to the media to the
+ *					payload handed to f_write (write amplification)
+ * Notes:			The disk layers (hostdisk.c, sdcard.c) report every sector
+ *					they read and write. The volume layout is learned from the
+ *					boot sector FatFs reads while mounting, so a partitioned
+ *					image works too. Directory clusters in the data area (the
+ *					FAT32 root directory and every sub-directory) count as
+ *					directory: the first FAT is shadowed from the sectors that
+ *					pass through the disk layers, the chains are followed from
+ *					the root cluster of the boot sector and from every cluster
+ *					whose first sector opens with its own "." entry. A
+ *					directory that was never read since the mount is not known
+ *					yet, but FatFs reads a directory before writing to it. The
+ *					payload is counted by wrapping f_write at link time
+ *					(-Wl,--wrap=f_write), leaving ff.c untouched.
+ *					DISK_STATS=1 prints the summary at exit and DISK_MAP=path
+ *					writes the per-sector map as CSV (sector,region,writes)
+ * -------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ff.h"
+#include "diskmap.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define DISKMAP_SECTOR_SIZE		512
+#define DISKMAP_CHUNK			65536		// Map grows in steps of this many sectors
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct diskmapLayout_t{
+	uint8_t		valid;
+	uint32_t	volumeBase;			// Boot sector
+	uint32_t	fsinfo;				// Absolute sector, 0 if none
+	uint32_t	fatBase;
+	uint32_t	fatSize;			// Sectors per FAT
+	uint8_t		fats;
+	uint32_t	dirBase;
+	uint32_t	dirSize;			// 0 on FAT32
+	uint32_t	dataBase;
+	uint8_t		clusterSize;		// Sectors per cluster
+	uint32_t	clusters;			// Data clusters (numbered from 2)
+	uint8_t		fatBits;			// 12, 16 or 32
+	uint32_t	rootCluster;		// FAT32 root directory, 0 otherwise
+} diskmapLayout_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+diskmapStats_t diskmapStats;
+
+static diskmapLayout_t layout;
+static uint32_t * writeCounts = 0;
+static uint32_t mapSectors = 0;
+
+static uint8_t * fatShadow = 0;				// First FAT as last read or written
+static uint8_t * dirClusters = 0;			// One bit per cluster of a directory chain
+static uint8_t dirDirty = 0;				// FAT or dirStarts changed since the bits were built
+static uint32_t * dirStarts = 0;			// First clusters of the sub-directories seen
+static uint32_t dirStartCount = 0;
+
+static const char * const regionNames[DISKMAP_REGIONS] = {
+	"unmapped", "boot", "fsinfo", "fat", "fat mirror", "dir", "data"
+};
+
+// -----------------------------------------------------------------------------
+// Private functions -----------------------------------------------------------
+
+static uint16_t loadWord(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t loadDword(const uint8_t * p)
+{
+	return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Same test as check_fs() in ff.c */
+static uint8_t isBootSector(const uint8_t * data)
+{
+	if(loadWord(&data[510]) != 0xAA55)
+		return 0;
+	return !memcmp(&data[54], "FAT", 3) || !memcmp(&data[82], "FAT32", 5);
+}
+
+static void learnLayout(uint32_t sector, const uint8_t * data)
+{
+	uint16_t reserved = loadWord(&data[14]);
+	uint16_t rootEntries = loadWord(&data[17]);
+	uint32_t fatSize = loadWord(&data[22]);
+	uint32_t totalSectors = loadWord(&data[19]);
+
+	if(!fatSize)
+		fatSize = loadDword(&data[36]);
+	if(!totalSectors)
+		totalSectors = loadDword(&data[32]);
+	if(layout.valid && (layout.volumeBase == sector))
+		return;								// Mounted again: keep the FAT shadow
+	layout.volumeBase = sector;
+	layout.fats = data[16];
+	layout.fatBase = sector + reserved;
+	layout.fatSize = fatSize;
+	layout.dirBase = layout.fatBase + layout.fats * fatSize;
+	layout.dirSize = (rootEntries * 32 + DISKMAP_SECTOR_SIZE - 1) / DISKMAP_SECTOR_SIZE;
+	layout.dataBase = layout.dirBase + layout.dirSize;
+	layout.fsinfo = rootEntries ? 0 : (sector + loadWord(&data[48]));
+	layout.clusterSize = data[13] ? data[13] : 1;
+	layout.clusters = (totalSectors - (layout.dataBase - sector)) / layout.clusterSize;
+	layout.fatBits = (layout.clusters < 4085) ? 12 : (layout.clusters < 65525) ? 16 : 32;	// As in chk_mounted()
+	layout.rootCluster = (layout.fatBits == 32) ? loadDword(&data[44]) : 0;
+	layout.valid = 1;
+
+	fatShadow = realloc(fatShadow, fatSize * DISKMAP_SECTOR_SIZE);
+	dirClusters = realloc(dirClusters, (layout.clusters + 2) / 8 + 1);
+	if(!fatShadow || !dirClusters){
+		perror("diskmap");
+		exit(EXIT_FAILURE);
+	}
+	memset(fatShadow, 0, fatSize * DISKMAP_SECTOR_SIZE);	// Unknown entries end the chains
+	dirStartCount = 0;
+	dirDirty = 1;
+}
+
+/* Next cluster of the chain in the FAT shadow */
+static uint32_t shadowNext(uint32_t cluster)
+{
+	uint32_t offset;
+
+	switch(layout.fatBits){
+	case 12:
+		offset = cluster + cluster / 2;
+		if(offset + 1 >= layout.fatSize * DISKMAP_SECTOR_SIZE)
+			return 0;
+		offset = loadWord(&fatShadow[offset]);
+		return (cluster & 1) ? (offset >> 4) : (offset & 0xFFF);
+	case 16:
+		return (cluster * 2 + 1 < layout.fatSize * DISKMAP_SECTOR_SIZE) ? loadWord(&fatShadow[cluster * 2]) : 0;
+	default:
+		return (cluster * 4 + 3 < layout.fatSize * DISKMAP_SECTOR_SIZE) ? (loadDword(&fatShadow[cluster * 4]) & 0x0FFFFFFF) : 0;
+	}
+}
+
+static void markChain(uint32_t cluster)
+{
+	while((cluster >= 2) && (cluster < layout.clusters + 2) && !(dirClusters[cluster >> 3] & (1 << (cluster & 7)))){
+		dirClusters[cluster >> 3] |= 1 << (cluster & 7);
+		cluster = shadowNext(cluster);
+	}
+}
+
+static void buildDirClusters(void)
+{
+	uint32_t i;
+
+	memset(dirClusters, 0, (layout.clusters + 2) / 8 + 1);
+	markChain(layout.rootCluster);
+	for(i = 0; i < dirStartCount; i++)
+		markChain(dirStarts[i]);
+	dirDirty = 0;
+}
+
+/* A sub-directory opens with a "." entry that points at its own cluster */
+static void noteClusterStart(uint32_t cluster, const uint8_t * data)
+{
+	uint32_t self = loadWord(&data[26]);
+	uint32_t i;
+
+	if(layout.fatBits == 32)
+		self |= (uint32_t)loadWord(&data[20]) << 16;
+	for(i = 0; (i < dirStartCount) && (dirStarts[i] != cluster); i++)
+		;
+	if(!memcmp(data, ".          ", 11) && (data[11] & 0x10) && (self == cluster)){
+		if(i < dirStartCount)
+			return;
+		dirStarts = realloc(dirStarts, (dirStartCount + 1) * sizeof(*dirStarts));
+		if(!dirStarts){
+			perror("diskmap");
+			exit(EXIT_FAILURE);
+		}
+		dirStarts[dirStartCount++] = cluster;
+	}else{
+		if(i == dirStartCount)
+			return;
+		dirStarts[i] = dirStarts[--dirStartCount];	// Reused for something else
+	}
+	dirDirty = 1;
+}
+
+/* Follows the contents of the first FAT and of the directory clusters */
+static void noteSector(uint32_t sector, const uint8_t * data)
+{
+	uint32_t offset;
+
+	if(!layout.valid || (sector < layout.fatBase))
+		return;
+	if(sector < layout.fatBase + layout.fatSize){
+		offset = (sector - layout.fatBase) * DISKMAP_SECTOR_SIZE;
+		if(memcmp(&fatShadow[offset], data, DISKMAP_SECTOR_SIZE)){
+			memcpy(&fatShadow[offset], data, DISKMAP_SECTOR_SIZE);
+			dirDirty = 1;
+		}
+	}else if((sector >= layout.dataBase) && !((sector - layout.dataBase) % layout.clusterSize)){
+		noteClusterStart((sector - layout.dataBase) / layout.clusterSize + 2, data);
+	}
+}
+
+static void countWrite(uint32_t sector)
+{
+	uint32_t size;
+
+	if(sector >= mapSectors){
+		size = (sector / DISKMAP_CHUNK + 1) * DISKMAP_CHUNK;
+		writeCounts = realloc(writeCounts, size * sizeof(*writeCounts));
+		if(!writeCounts){
+			perror("diskmap");
+			exit(EXIT_FAILURE);
+		}
+		memset(&writeCounts[mapSectors], 0, (size - mapSectors) * sizeof(*writeCounts));
+		mapSectors = size;
+	}
+	writeCounts[sector]++;
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+void diskmapRead(uint32_t sector, const uint8_t * data, uint32_t count)
+{
+	uint32_t i;
+
+	for(i = 0; i < count; i++, data += DISKMAP_SECTOR_SIZE){
+		if(isBootSector(data))
+			learnLayout(sector + i, data);
+		else
+			noteSector(sector + i, data);
+	}
+}
+
+void diskmapWrite(uint32_t sector, const uint8_t * data, uint32_t count)
+{
+	uint32_t i;
+
+	diskmapStats.writeCalls++;
+	for(i = 0; i < count; i++, data += DISKMAP_SECTOR_SIZE)
+		noteSector(sector + i, data);
+	for(; count; count--, sector++){
+		diskmapStats.sectors[diskmapClassify(sector)]++;
+		countWrite(sector);
+	}
+}
+
+diskmapRegion_t diskmapClassify(uint32_t sector)
+{
+	uint32_t cluster;
+
+	if(!layout.valid || (sector < layout.volumeBase))
+		return DISKMAP_UNMAPPED;
+	if(layout.fsinfo && (sector == layout.fsinfo))
+		return DISKMAP_FSINFO;
+	if(sector < layout.fatBase)
+		return DISKMAP_BOOT;
+	if(sector < layout.fatBase + layout.fatSize)
+		return DISKMAP_FAT;
+	if(sector < layout.dirBase)
+		return DISKMAP_FAT_MIRROR;
+	if(sector < layout.dataBase)
+		return DISKMAP_DIR;
+	if(dirDirty)
+		buildDirClusters();
+	cluster = (sector - layout.dataBase) / layout.clusterSize + 2;
+	if((cluster < layout.clusters + 2) && (dirClusters[cluster >> 3] & (1 << (cluster & 7))))
+		return DISKMAP_DIR;
+	return DISKMAP_DATA;
+}
+
+double diskmapAmplification(void)
+{
+	uint64_t sectors = 0;
+	uint8_t i;
+
+	for(i = 0; i < DISKMAP_REGIONS; i++)
+		sectors += diskmapStats.sectors[i];
+	if(!diskmapStats.payloadBytes)
+		return 0;
+	return (double)(sectors * DISKMAP_SECTOR_SIZE) / diskmapStats.payloadBytes;
+}
+
+void diskmapPrintStats(FILE * stream)
+{
+	uint64_t total = 0;
+	uint32_t distinct[DISKMAP_REGIONS] = {0};
+	uint32_t hottest[DISKMAP_REGIONS] = {0};
+	uint32_t hottestSector[DISKMAP_REGIONS] = {0};
+	diskmapRegion_t region;
+	uint32_t sector;
+	uint8_t i;
+
+	for(sector = 0; sector < mapSectors; sector++){
+		if(!writeCounts[sector])
+			continue;
+		region = diskmapClassify(sector);
+		distinct[region]++;
+		if(writeCounts[sector] > hottest[region]){
+			hottest[region] = writeCounts[sector];
+			hottestSector[region] = sector;
+		}
+	}
+	for(i = 0; i < DISKMAP_REGIONS; i++)
+		total += diskmapStats.sectors[i];
+
+	fprintf(stream, "diskmap: %llu payload bytes, %llu bytes written in %llu calls, amplification %.2f\n",
+		(unsigned long long)diskmapStats.payloadBytes, (unsigned long long)(total * DISKMAP_SECTOR_SIZE),
+		(unsigned long long)diskmapStats.writeCalls, diskmapAmplification());
+	fprintf(stream, "  %-10s %10s %8s %10s %10s\n", "region", "sectors", "share", "distinct", "hottest");
+	for(i = 0; i < DISKMAP_REGIONS; i++){
+		if(!diskmapStats.sectors[i])
+			continue;
+		fprintf(stream, "  %-10s %10llu %7.1f%% %10u %10u (sector %u)\n", regionNames[i],
+			(unsigned long long)diskmapStats.sectors[i], 100.0 * diskmapStats.sectors[i] / total,
+			distinct[i], hottest[i], hottestSector[i]);
+	}
+}
+
+void diskmapDump(FILE * stream)
+{
+	uint32_t sector;
+
+	fprintf(stream, "sector,region,writes\n");
+	for(sector = 0; sector < mapSectors; sector++){
+		if(writeCounts[sector])
+			fprintf(stream, "%u,%s,%u\n", sector, regionNames[diskmapClassify(sector)], writeCounts[sector]);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// f_write wrapper -------------------------------------------------------------
+
+FRESULT __real_f_write(FIL * fp, const void * buff, UINT btw, UINT * bw);
+
+FRESULT __wrap_f_write(FIL * fp, const void * buff, UINT btw, UINT * bw)
+{
+	FRESULT result = __real_f_write(fp, buff, btw, bw);
+
+	diskmapStats.payloadBytes += *bw;
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// Initialization --------------------------------------------------------------
+
+static void diskmapFinish(void)
+{
+	const char * path = getenv("DISK_MAP");
+	FILE * stream;
+
+	if(getenv("DISK_STATS"))
+		diskmapPrintStats(stderr);
+	if(path){
+		stream = fopen(path, "w");
+		if(stream){
+			diskmapDump(stream);
+			fclose(stream);
+		}else{
+			perror(path);
+		}
+	}
+}
+
+__attribute__((constructor)) static void diskmapInit(void)
+{
+	atexit(diskmapFinish);
+}
@@ -0,0 +1,52 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			diskmap.h
+ * Module:			Sector write accounting
+ * Purpose:			Tags every sector written to the media as boot, FSInfo,
+ *					FAT, FAT mirror, directory or data, keeps a write count per
+ *					sector and relates the bytes written to the media to the
+ *					payload handed to f_write (write amplification)
+ * -------------------------------------------------------------------------- */
+
+#ifndef __DISKMAP_H
+#define __DISKMAP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef enum diskmapRegion_t{
+	DISKMAP_UNMAPPED = 0,			// Written before the volume was recognised
+	DISKMAP_BOOT,					// Boot sector and other reserved sectors
+	DISKMAP_FSINFO,					// FAT32 FSInfo sector
+	DISKMAP_FAT,					// First FAT copy
+	DISKMAP_FAT_MIRROR,				// Other FAT copies
+	DISKMAP_DIR,					// FAT12/16 root directory and directory clusters
+	DISKMAP_DATA,					// Cluster area (file data)
+	DISKMAP_REGIONS
+} diskmapRegion_t;
+
+typedef struct diskmapStats_t{
+	uint64_t	payloadBytes;				// Bytes accepted by f_write
+	uint64_t	writeCalls;					// Writes issued to the media
+	uint64_t	sectors[DISKMAP_REGIONS];	// Sectors written per region
+} diskmapStats_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+extern diskmapStats_t diskmapStats;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+void			diskmapRead(uint32_t sector, const uint8_t * data, uint32_t count);
+void			diskmapWrite(uint32_t sector, const uint8_t * data, uint32_t count);
+diskmapRegion_t	diskmapClassify(uint32_t sector);
+double			diskmapAmplification(void);
+void			diskmapPrintStats(FILE * stream);
+void			diskmapDump(FILE * stream);
+
+#endif
@@ -0,0 +1,229 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			ds1307model.c
+ * Module:			DS1307 Real Time Clock model (I2C slave)
+ * Purpose:			Answers at address 0x68 on the emulated TWI bus with the
+ *					DS1307 register map: 0x00-0x07 BCD time and control,
+ *					0x08-0x3F 56 bytes of NVRAM, register pointer wrapping at
+ *					0x3F. Time advances at 1 Hz on the virtual clock while the
+ *					CH bit is clear
+ * Notes:			Linking this module plugs the RTC into the TWI bus. The
+ *					initial time comes from RTC_TIME ("YYYY-MM-DD HH:MM:SS",
+ *					default 2019-06-19 15:35:00); TWI_STATS=1 prints the bus
+ *					usage at exit
+ * -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostio.h"
+#include "hostclock.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define DS1307_MODEL_ADDRESS	0x68
+#define DS1307_MODEL_REGISTERS	0x40
+
+#define REG_SECONDS				0x00
+#define REG_MINUTES				0x01
+#define REG_HOURS				0x02
+#define REG_WEEK_DAY			0x03
+#define REG_MONTH_DAY			0x04
+#define REG_MONTH				0x05
+#define REG_YEAR				0x06
+#define REG_CONTROL				0x07
+
+#define SECONDS_CH				7		// Clock halt
+#define HOURS_12				6		// 12 hour mode
+#define HOURS_PM				5		// PM flag in 12 hour mode
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+static uint8_t registers[DS1307_MODEL_REGISTERS] = {
+	[REG_SECONDS] = 0x00,
+	[REG_MINUTES] = 0x35,
+	[REG_HOURS] = 0x15,
+	[REG_WEEK_DAY] = 0x04,
+	[REG_MONTH_DAY] = 0x19,
+	[REG_MONTH] = 0x06,
+	[REG_YEAR] = 0x19,
+	[REG_CONTROL] = 0x03
+};
+static uint8_t pointer = 0;				// Register pointer
+static uint8_t pointerPending = 0;		// Next written byte sets the pointer
+static uint64_t lastTick = 0;			// Virtual clock cycle of the last 1 Hz tick
+
+// -----------------------------------------------------------------------------
+// Time keeping ----------------------------------------------------------------
+
+static uint8_t bcdToBin(uint8_t value)
+{
+	return (value >> 4) * 10 + (value & 0x0F);
+}
+
+static uint8_t binToBcd(uint8_t value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+static uint8_t monthLength(uint8_t month, uint8_t year)
+{
+	static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	if((month < 1) || (month > 12))
+		return 31;
+	if((month == 2) && !(year % 4))		// 2000-2099: every fourth year
+		return 29;
+	return days[month - 1];
+}
+
+/* Carries a BCD field; returns 1 when the field wrapped */
+static uint8_t carry(uint8_t reg, uint8_t mask, uint8_t first, uint8_t last)
+{
+	uint8_t value = bcdToBin(registers[reg] & mask) + 1;
+	uint8_t wrapped = (value > last);
+
+	if(wrapped)
+		value = first;
+	registers[reg] = (registers[reg] & ~mask) | binToBcd(value);
+	return wrapped;
+}
+
+static uint8_t carryHours(void)
+{
+	uint8_t hours = registers[REG_HOURS];
+	uint8_t value;
+
+	if(!(hours & (1 << HOURS_12)))
+		return carry(REG_HOURS, 0x3F, 0, 23);
+
+	value = bcdToBin(hours & 0x1F) + 1;
+	if(value == 12)						// 11:59:59 -> 12:00:00 toggles AM/PM
+		hours ^= (1 << HOURS_PM);
+	if(value > 12)
+		value = 1;
+	registers[REG_HOURS] = (hours & ~0x1F) | binToBcd(value);
+	return (value == 12) && !(registers[REG_HOURS] & (1 << HOURS_PM));
+}
+
+static void tick(void)
+{
+	uint8_t year = bcdToBin(registers[REG_YEAR]);
+	uint8_t month = bcdToBin(registers[REG_MONTH] & 0x1F);
+
+	if(!carry(REG_SECONDS, 0x7F, 0, 59))
+		return;
+	if(!carry(REG_MINUTES, 0x7F, 0, 59))
+		return;
+	if(!carryHours())
+		return;
+	carry(REG_WEEK_DAY, 0x07, 1, 7);
+	if(!carry(REG_MONTH_DAY, 0x3F, 1, monthLength(month, year)))
+		return;
+	if(!carry(REG_MONTH, 0x1F, 1, 12))
+		return;
+	carry(REG_YEAR, 0xFF, 0, 99);
+}
+
+/* Applies the 1 Hz ticks elapsed since the last access */
+static void update(void)
+{
+	uint64_t now = hostClockCycles();
+
+	if(registers[REG_SECONDS] & (1 << SECONDS_CH)){
+		lastTick = now;					// The oscillator is stopped
+		return;
+	}
+	while(now - lastTick >= F_CPU){
+		lastTick += F_CPU;
+		tick();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Bus interface ---------------------------------------------------------------
+
+/* The device latches the time into its user buffer on START */
+static uint8_t ds1307ModelStart(uint8_t readWrite)
+{
+	update();
+	pointerPending = !readWrite;
+	return 1;
+}
+
+static uint8_t ds1307ModelWrite(uint8_t data)
+{
+	if(pointerPending){
+		pointer = data % DS1307_MODEL_REGISTERS;
+		pointerPending = 0;
+		return 1;
+	}
+	if(pointer == REG_SECONDS)			// Writing the seconds resets the countdown chain
+		lastTick = hostClockCycles();
+	registers[pointer] = data;
+	pointer = (pointer + 1) % DS1307_MODEL_REGISTERS;
+	return 1;
+}
+
+static uint8_t ds1307ModelRead(uint8_t ack)
+{
+	uint8_t data = registers[pointer];
+
+	pointer = (pointer + 1) % DS1307_MODEL_REGISTERS;
+	return data;
+}
+
+static void ds1307ModelStop(void)
+{
+	pointerPending = 0;
+}
+
+static const hostTwiSlave_t ds1307Model = {
+	.address = DS1307_MODEL_ADDRESS,
+	.start = ds1307ModelStart,
+	.write = ds1307ModelWrite,
+	.read = ds1307ModelRead,
+	.stop = ds1307ModelStop
+};
+
+// -----------------------------------------------------------------------------
+// Initialization --------------------------------------------------------------
+
+static void ds1307ModelStats(void)
+{
+	if(!getenv("TWI_STATS"))
+		return;
+	fprintf(stderr, "twi: %llu transfers, %llu bytes, bus time %.6f s, scl %u cycles\n",
+		(unsigned long long)hostTwiStats.transfers, (unsigned long long)hostTwiStats.bytes,
+		(double)hostTwiStats.cycles / F_CPU, hostTwiSclCycles());
+}
+
+__attribute__((constructor)) static void ds1307ModelInsert(void)
+{
+	const char * env = getenv("RTC_TIME");
+	unsigned int year, month, day, hours, minutes, seconds;
+	uint8_t weekDay;
+	int y, m;
+
+	if(env && (sscanf(env, "%u-%u-%u %u:%u:%u", &year, &month, &day, &hours, &minutes, &seconds) == 6)){
+		// Zeller congruence, 1 = Sunday
+		y = year;
+		m = month;
+		if(m < 3){
+			m += 12;
+			y--;
+		}
+		weekDay = ((day + (13 * (m + 1)) / 5 + y + y / 4 - y / 100 + y / 400 + 6) % 7) + 1;
+		registers[REG_SECONDS] = binToBcd(seconds % 60);
+		registers[REG_MINUTES] = binToBcd(minutes % 60);
+		registers[REG_HOURS] = binToBcd(hours % 24);
+		registers[REG_WEEK_DAY] = weekDay;
+		registers[REG_MONTH_DAY] = binToBcd(day % 32);
+		registers[REG_MONTH] = binToBcd(month % 13);
+		registers[REG_YEAR] = binToBcd(year % 100);
+	}
+
+	hostTwiAttach(&ds1307Model);
+	atexit(ds1307ModelStats);
+}
@@ -0,0 +1,251 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			fsbench.c
+ * Module:			Storage throughput benchmark
+ * Purpose:			Runs parameterized append workloads through f_open, f_write
+ *					and f_sync with the FatFs configuration of the firmware
+ *					(ffconf.h) over the file-backed diskio, and reports records
+ *					per second, disk calls and sectors per record, the sectors
+ *					per record of each FAT region and the write amplification
+ *					as CSV
+ * Usage:			fsbench [-r sizes] [-s intervals] [-f bytes] [-n name]
+ *					-r	record sizes in bytes, comma separated (16..512,
+ *						default 16,32,64,128,256,512)
+ *					-s	f_sync every N records, comma separated; 0 syncs only
+ *						at f_close (default 1,8,64,0)
+ *					-f	bytes written per workload, k/M suffixes accepted, or
+ *						"max" to fill the image (default 1M)
+ *					-n	file name (default Radiacao.csv)
+ *					The image comes from SD_IMAGE (default "sd.mmc"). f_unlink
+ *					is compiled out of ff.c, so the file is emptied with
+ *					FA_CREATE_ALWAYS before and after every workload
+ * -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "ff.h"
+#include "hostdisk.h"
+#include "diskmap.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define BENCH_MAX_LIST			16
+#define BENCH_MIN_RECORD		16
+#define BENCH_MAX_RECORD		512
+#define BENCH_FILL				0xFFFFFFFFUL
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct benchResult_t{
+	uint32_t	records;
+	uint32_t	bytes;
+	double		seconds;
+	HOSTDISK_STATS	disk;				// Disk layer calls made by the workload
+	diskmapStats_t	map;				// Sectors per region and payload of the workload
+	FRESULT		result;
+} benchResult_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+static FATFS fileSystem;
+static char record[BENCH_MAX_RECORD];
+
+// -----------------------------------------------------------------------------
+// Private functions -----------------------------------------------------------
+
+static double wallSeconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static uint8_t parseList(const char * text, uint32_t * list)
+{
+	uint8_t count = 0;
+	char * end;
+
+	while(*text && (count < BENCH_MAX_LIST)){
+		list[count++] = (uint32_t)strtoul(text, &end, 0);
+		if(end == text)
+			return 0;
+		text = (*end == ',') ? (end + 1) : end;
+	}
+	return count;
+}
+
+static uint32_t parseSize(const char * text)
+{
+	char * unit;
+	uint32_t value;
+
+	if(!strcmp(text, "max"))
+		return BENCH_FILL;
+	value = (uint32_t)strtoul(text, &unit, 0);
+	if((*unit == 'k') || (*unit == 'K'))
+		value *= 1024;
+	else if(*unit == 'M')
+		value *= 1024 * 1024;
+	return value;
+}
+
+/* A CSV-like line of the requested size, as main.c would log it */
+static void buildRecord(uint32_t size)
+{
+	uint32_t i;
+
+	for(i = 0; i < size - 1; i++)
+		record[i] = ((i % 8) == 7) ? ';' : ('0' + (i % 10));
+	record[size - 1] = '\n';
+}
+
+static void diskDelta(HOSTDISK_STATS * delta, const HOSTDISK_STATS * before)
+{
+	delta->read_calls = HostDiskStats.read_calls - before->read_calls;
+	delta->write_calls = HostDiskStats.write_calls - before->write_calls;
+	delta->sync_calls = HostDiskStats.sync_calls - before->sync_calls;
+	delta->sectors_read = HostDiskStats.sectors_read - before->sectors_read;
+	delta->sectors_written = HostDiskStats.sectors_written - before->sectors_written;
+}
+
+static void mapDelta(diskmapStats_t * delta, const diskmapStats_t * before)
+{
+	uint8_t i;
+
+	delta->payloadBytes = diskmapStats.payloadBytes - before->payloadBytes;
+	delta->writeCalls = diskmapStats.writeCalls - before->writeCalls;
+	for(i = 0; i < DISKMAP_REGIONS; i++)
+		delta->sectors[i] = diskmapStats.sectors[i] - before->sectors[i];
+}
+
+static void truncateFile(const char * name)
+{
+	FIL file;
+
+	if(f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK)
+		f_close(&file);
+}
+
+static void runWorkload(const char * name, uint32_t recordSize, uint32_t syncEvery, uint32_t fileBytes, benchResult_t * result)
+{
+	FIL file;
+	UINT written;
+	HOSTDISK_STATS before;
+	diskmapStats_t mapBefore;
+	double start;
+
+	memset(result, 0, sizeof(*result));
+	buildRecord(recordSize);
+	f_mount(0, &fileSystem);
+	truncateFile(name);
+
+	before = HostDiskStats;
+	mapBefore = diskmapStats;
+	start = wallSeconds();
+	result->result = f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS);
+	if(result->result != FR_OK)
+		return;
+	while(result->bytes + recordSize <= fileBytes){
+		result->result = f_write(&file, record, recordSize, &written);
+		result->bytes += written;
+		if((result->result != FR_OK) || (written < recordSize))
+			break;						// Disk full
+		result->records++;
+		if(syncEvery && !(result->records % syncEvery)){
+			result->result = f_sync(&file);
+			if(result->result != FR_OK)
+				break;
+		}
+	}
+	if(f_close(&file) != FR_OK)
+		result->result = FR_DISK_ERR;
+	result->seconds = wallSeconds() - start;
+	diskDelta(&result->disk, &before);
+	mapDelta(&result->map, &mapBefore);
+
+	truncateFile(name);
+	f_mount(0, NULL);
+}
+
+static void printResult(uint32_t recordSize, uint32_t syncEvery, const benchResult_t * result)
+{
+	double records = result->records ? result->records : 1;
+	double payload = result->map.payloadBytes ? result->map.payloadBytes : 1;
+
+	printf("%u,%u,%u,%u,%d,%.6f,%.0f,%.4f,%.4f,%.4f,%.4f,%u,%.4f,%.4f,%.4f,%.4f,%.2f\n",
+		recordSize, syncEvery, result->records, result->bytes, result->result, result->seconds,
+		(result->seconds > 0) ? (result->records / result->seconds) : 0.0,
+		result->disk.read_calls / records, result->disk.write_calls / records,
+		result->disk.sectors_read / records, result->disk.sectors_written / records,
+		result->disk.sync_calls,
+		result->map.sectors[DISKMAP_DATA] / records, result->map.sectors[DISKMAP_FAT] / records,
+		result->map.sectors[DISKMAP_FAT_MIRROR] / records, result->map.sectors[DISKMAP_DIR] / records,
+		result->disk.sectors_written * 512.0 / payload);
+}
+
+static void usage(const char * program)
+{
+	fprintf(stderr, "usage: %s [-r sizes] [-s intervals] [-f bytes|max] [-n name]\n", program);
+	exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+// Main function ---------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	uint32_t sizes[BENCH_MAX_LIST] = {16, 32, 64, 128, 256, 512};
+	uint32_t intervals[BENCH_MAX_LIST] = {1, 8, 64, 0};
+	uint8_t sizeCount = 6;
+	uint8_t intervalCount = 4;
+	uint32_t fileBytes = 1024UL * 1024UL;
+	const char * name = "Radiacao.csv";
+	benchResult_t result;
+	uint8_t i, j;
+	int option;
+
+	while((option = getopt(argc, argv, "r:s:f:n:")) != -1){
+		switch(option){
+		case 'r':
+			sizeCount = parseList(optarg, sizes);
+			break;
+		case 's':
+			intervalCount = parseList(optarg, intervals);
+			break;
+		case 'f':
+			fileBytes = parseSize(optarg);
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if(!sizeCount || !intervalCount || !fileBytes)
+		usage(argv[0]);
+	for(i = 0; i < sizeCount; i++){
+		if((sizes[i] < BENCH_MIN_RECORD) || (sizes[i] > BENCH_MAX_RECORD))
+			usage(argv[0]);
+	}
+
+	printf("record_size,sync_every,records,bytes,result,seconds,records_per_s,"
+		"reads_per_record,writes_per_record,sectors_read_per_record,sectors_written_per_record,syncs,"
+		"data_per_record,fat_per_record,fat_mirror_per_record,dir_per_record,amplification\n");
+	for(i = 0; i < sizeCount; i++){
+		for(j = 0; j < intervalCount; j++){
+			runWorkload(name, sizes[i], intervals[j], fileBytes, &result);
+			printResult(sizes[i], intervals[j], &result);
+			fflush(stdout);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			hostclock.c
+ * Module:			Virtual time base
+ * Purpose:			Counts simulated CPU cycles at F_CPU. Busy-wait delays and
+ *					peripheral models advance it; nothing ever sleeps on the host,
+ *					so simulated time runs as fast as the host CPU allows
+ * Notes:			The firmware main loop never returns, so the run is bounded
+ *					by HOST_RUN_TIME (simulated time with an s/m/h/d suffix,
+ *					e.g. "7d") or HOST_RUN_SECONDS (default 60). CLOCK_STATS=1
+ *					prints the wall clock cost of every simulated day and a
+ *					summary at exit. HOST_POWER_FAIL_MS=t pulls the power-fail
+ *					input (PD2, INT0) low t ms before the end of the run
+ * -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hostclock.h"
+#include "hostio.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define HOST_CYCLES_PER_DAY		(86400ULL * F_CPU)
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+hostClockStats_t hostClockStats;
+
+static uint64_t hostCycles = 0;
+static uint64_t hostRunLimit = 60ULL * F_CPU;
+static uint64_t hostEnd = 0;			// Cycle the current advance runs to
+static uint8_t hostAdvancing = 0;
+static uint8_t hostReport = 0;
+static uint64_t hostNextDay = HOST_CYCLES_PER_DAY;
+static double hostWallStart = 0;
+static double hostDayWall = 0;			// Wall clock at the start of the current day
+
+// -----------------------------------------------------------------------------
+// Private functions -----------------------------------------------------------
+
+static double wallSeconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* "90", "90s", "15m", "12h" or "7d" */
+static uint64_t parseDuration(const char * text)
+{
+	char * unit;
+	double value = strtod(text, &unit);
+
+	switch(*unit){
+	case 'm':
+		value *= 60;
+		break;
+	case 'h':
+		value *= 3600;
+		break;
+	case 'd':
+		value *= 86400;
+		break;
+	default:
+		break;
+	}
+	return (uint64_t)(value * F_CPU);
+}
+
+static void dayReport(void)
+{
+	double wall = wallSeconds();
+
+	hostClockStats.days++;
+	fprintf(stderr, "clock: day %u simulated in %.3f s wall\n", hostClockStats.days, wall - hostDayWall);
+	hostDayWall = wall;
+	hostNextDay += HOST_CYCLES_PER_DAY;
+}
+
+static void hostClockFinish(void)
+{
+	double simulated = (double)hostCycles / F_CPU;
+	double wall = wallSeconds() - hostWallStart;
+
+	if(!hostReport)
+		return;
+	fprintf(stderr, "clock: %.3f s simulated in %.3f s wall (%.0fx), %.3f s wall per simulated day\n",
+		simulated, wall, (wall > 0) ? (simulated / wall) : 0.0, (simulated > 0) ? (wall * 86400 / simulated) : 0.0);
+	fprintf(stderr, "clock: %llu advances, %llu peripheral events\n",
+		(unsigned long long)hostClockStats.advances, (unsigned long long)hostClockStats.events);
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* Runs the peripheral events that fall inside the interval, so interrupt
+ * vectors see the clock at the cycle they fire. Cycles spent inside a vector
+ * (bus transfers, delays) extend the interval. The run ends exactly at the
+ * limit, after the events due until then */
+void hostClockAdvance(uint64_t cycles)
+{
+	uint64_t next;
+
+	if(hostAdvancing){
+		hostCycles += cycles;
+		hostEnd += cycles;
+		return;
+	}
+	hostAdvancing = 1;
+	hostClockStats.advances++;
+	hostEnd = hostCycles + cycles;
+	next = hostIoRun(hostCycles);
+	while(next <= hostEnd){
+		if(next > hostRunLimit)
+			break;
+		if(next > hostCycles)
+			hostCycles = next;
+		hostClockStats.events++;
+		next = hostIoRun(hostCycles);
+	}
+	hostCycles = hostEnd;
+	hostAdvancing = 0;
+	if(hostReport && (hostCycles >= hostNextDay))
+		dayReport();
+	if(hostCycles >= hostRunLimit){
+		hostCycles = hostRunLimit;
+		exit(EXIT_SUCCESS);		// atexit handlers flush the image and the stats
+	}
+}
+
+void hostClockDelayUs(double us)
+{
+	if(us > 0)
+		hostClockAdvance((uint64_t)(us * HOST_CYCLES_PER_US));
+}
+
+uint64_t hostClockCycles(void)
+{
+	return hostCycles;
+}
+
+uint64_t hostClockMicroseconds(void)
+{
+	return hostCycles / HOST_CYCLES_PER_US;
+}
+
+// -----------------------------------------------------------------------------
+// Initialization --------------------------------------------------------------
+
+__attribute__((constructor)) static void hostClockInit(void)
+{
+	const char * env;
+
+	if((env = getenv("HOST_RUN_TIME")))
+		hostRunLimit = parseDuration(env);
+	else if((env = getenv("HOST_RUN_SECONDS")))
+		hostRunLimit = (uint64_t)(atof(env) * F_CPU);
+	if((env = getenv("HOST_POWER_FAIL_MS")))	// Power-fail warning this long before the end
+		hostPowerFailAt(hostRunLimit - (uint64_t)(atof(env) * F_CPU / 1000));
+	hostReport = getenv("CLOCK_STATS") ? 1 : 0;
+	hostWallStart = wallSeconds();
+	hostDayWall = hostWallStart;
+	atexit(hostClockFinish);
+}
@@ -0,0 +1,43 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			hostclock.h
+ * Module:			Virtual time base
+ * Purpose:			Counts simulated CPU cycles at F_CPU. Busy-wait delays and
+ *					peripheral models advance it; nothing ever sleeps on the host,
+ *					so simulated time runs as fast as the host CPU allows
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOSTCLOCK_H
+#define __HOSTCLOCK_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+	#define F_CPU 16000000UL
+#endif
+
+#define HOST_CYCLES_PER_US		(F_CPU / 1000000UL)
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct hostClockStats_t{
+	uint64_t	advances;			// Calls that moved the clock
+	uint64_t	events;				// Peripheral events dispatched (overflows, conversions)
+	uint32_t	days;				// Simulated days completed
+} hostClockStats_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+extern hostClockStats_t hostClockStats;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+void		hostClockAdvance(uint64_t cycles);
+void		hostClockDelayUs(double us);
+uint64_t	hostClockCycles(void);
+uint64_t	hostClockMicroseconds(void);
+
+#endif
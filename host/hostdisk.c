@@ -0,0 +1,195 @@
+/*------------------------------------------------------------------------/
+/  Disk image control module for the host (PC) build
+/-------------------------------------------------------------------------/
+/
+/  Implements the diskio.h contract over a regular file holding a raw card
+/  image (sd.mmc from sd.zip), so the unmodified FatFs core and main.c can
+/  run on a PC. The image path is taken from the SD_IMAGE environment
+/  variable and defaults to "sd.mmc" in the working directory.
+/
+/-------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "diskio.h"
+#include "hostdisk.h"
+#include "diskmap.h"
+
+
+#define SECTOR_SIZE	512
+
+
+static
+DSTATUS Stat = STA_NOINIT;	/* Disk status */
+
+static
+int ImageFd = -1;			/* File descriptor of the image */
+
+static
+DWORD ImageSectors;			/* Size of the image in sectors */
+
+HOSTDISK_STATS HostDiskStats;	/* Access counters */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Close the image when the process exits                                */
+/*-----------------------------------------------------------------------*/
+
+static
+void close_image (void)
+{
+	if (ImageFd >= 0) {
+		fsync(ImageFd);
+		close(ImageFd);
+		ImageFd = -1;
+	}
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get Disk Status                                                       */
+/*-----------------------------------------------------------------------*/
+
+DSTATUS disk_status (
+	BYTE drv			/* Drive number (always 0) */
+)
+{
+	if (drv) return STA_NOINIT;		/* Supports only single drive */
+	return Stat;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Initialize Disk Drive                                                 */
+/*-----------------------------------------------------------------------*/
+
+DSTATUS disk_initialize (
+	BYTE drv		/* Physical drive nmuber (0) */
+)
+{
+	const char *path;
+	struct stat st;
+
+
+	if (drv) return STA_NOINIT;
+	if (ImageFd < 0) {
+		path = getenv("SD_IMAGE");
+		if (!path) path = "sd.mmc";
+		ImageFd = open(path, O_RDWR);
+		if (ImageFd < 0) {
+			Stat = STA_NOINIT | STA_NODISK;
+			return Stat;
+		}
+		if (fstat(ImageFd, &st) == 0)
+			ImageSectors = (DWORD)(st.st_size / SECTOR_SIZE);
+		atexit(close_image);
+	}
+	Stat = 0;
+
+	return Stat;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Read Sector(s)                                                        */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_read (
+	BYTE drv,			/* Physical drive nmuber (0) */
+	BYTE *buff,			/* Pointer to the data buffer to store read data */
+	DWORD sector,		/* Start sector number (LBA) */
+	BYTE count			/* Sector count (1..128) */
+)
+{
+	ssize_t n = (ssize_t)count * SECTOR_SIZE;
+
+
+	if (disk_status(drv) & STA_NOINIT) return RES_NOTRDY;
+	if (!count) return RES_PARERR;
+	if (sector + count > ImageSectors) return RES_PARERR;
+
+	HostDiskStats.read_calls++;
+	HostDiskStats.sectors_read += count;
+	if (pread(ImageFd, buff, n, (off_t)sector * SECTOR_SIZE) != n)
+		return RES_ERROR;
+	diskmapRead(sector, buff, count);
+
+	return RES_OK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s)                                                       */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_write (
+	BYTE drv,			/* Physical drive nmuber (0) */
+	const BYTE *buff,	/* Pointer to the data to be written */
+	DWORD sector,		/* Start sector number (LBA) */
+	BYTE count			/* Sector count (1..128) */
+)
+{
+	ssize_t n = (ssize_t)count * SECTOR_SIZE;
+
+
+	if (disk_status(drv) & STA_NOINIT) return RES_NOTRDY;
+	if (!count) return RES_PARERR;
+	if (sector + count > ImageSectors) return RES_PARERR;
+
+	HostDiskStats.write_calls++;
+	HostDiskStats.sectors_written += count;
+	if (pwrite(ImageFd, buff, n, (off_t)sector * SECTOR_SIZE) != n)
+		return RES_ERROR;
+	diskmapWrite(sector, buff, count);
+
+	return RES_OK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Miscellaneous Functions                                               */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_ioctl (
+	BYTE drv,		/* Physical drive nmuber (0) */
+	BYTE ctrl,		/* Control code */
+	void *buff		/* Buffer to send/receive control data */
+)
+{
+	DRESULT res;
+
+
+	if (disk_status(drv) & STA_NOINIT)
+		return RES_NOTRDY;
+
+	switch (ctrl) {
+		case CTRL_SYNC :		/* Image writes are not cached by this layer */
+			HostDiskStats.sync_calls++;
+			res = RES_OK;
+			break;
+
+		case GET_SECTOR_COUNT :	/* Get number of sectors on the disk (DWORD) */
+			*(DWORD*)buff = ImageSectors;
+			res = RES_OK;
+			break;
+
+		case GET_BLOCK_SIZE :	/* Get erase block size in unit of sector (DWORD) */
+			*(DWORD*)buff = 128;
+			res = RES_OK;
+			break;
+
+		default:
+			res = RES_PARERR;
+	}
+
+	return res;
+}
@@ -0,0 +1,22 @@
+/*-----------------------------------------------------------------------
+/  Disk image control module for the host (PC) build
+/-----------------------------------------------------------------------*/
+
+#ifndef _HOSTDISK
+#define _HOSTDISK
+
+#include "integer.h"
+
+
+/* Access counters of the disk layer */
+typedef struct {
+	DWORD	read_calls;			/* disk_read() calls */
+	DWORD	write_calls;		/* disk_write() calls */
+	DWORD	sync_calls;			/* disk_ioctl(CTRL_SYNC) calls */
+	DWORD	sectors_read;		/* Sectors transferred by disk_read() */
+	DWORD	sectors_written;	/* Sectors transferred by disk_write() */
+} HOSTDISK_STATS;
+
+extern HOSTDISK_STATS HostDiskStats;
+
+#endif
@@ -0,0 +1,672 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			hostio.c
+ * Module:			Emulated I/O space and interrupt controller
+ * Purpose:			Holds the ATmega328P register file used by <avr/io.h>,
+ *					dispatches interrupt vectors and runs the peripheral models
+ *					that react to register accesses
+ * Notes:			C gives no hook on a plain store, so peripherals that act on
+ *					writes are evaluated lazily on the next access of the same
+ *					register. The firmware always polls those registers, which
+ *					is what drives the models forward
+ * -------------------------------------------------------------------------- */
+
+#include "hostio.h"
+#include "hostclock.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define HOST_NEVER				UINT64_MAX
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+volatile uint8_t hostIoSpace[HOST_IO_SPACE_SIZE] __attribute__((aligned(HOST_IO_SPACE_SIZE))) = {
+	[0x29] = (1 << PD2),				// PIND: power-fail input high (supply good)
+	[0x5D] = (uint8_t)RAMEND,			// SPL
+	[0x5E] = (uint8_t)(RAMEND >> 8),	// SPH
+	[0xB9] = 0xF8,						// TWSR: no relevant state
+	[0xBB] = 0xFF,						// TWDR
+	[0xC0] = (1 << UDRE0)				// UCSR0A: transmit buffer empty
+};
+
+hostSpiStats_t hostSpiStats;
+
+static hostSpiDevice_t spiDevice = 0;
+static uint8_t spiFlag = 0;				// Hardware SPIF flag
+static uint8_t spiFlagSeen = 0;			// SPSR read while SPIF was set
+static uint8_t spiWrites = 0;			// SPDR accesses that can only be writes
+static uint8_t spiMaybeWrite = 0;		// The SPIF clearing access may have been a write
+static uint8_t spiIdlePolls = 0;
+static uint8_t spiReceived = 0xFF;
+static uint16_t spiSck = 128;			// F_CPU/SCK of the byte being shifted (SPI or MSPIM)
+
+static uint8_t uspiShifting = 0;		// USART0 MSPIM: byte in the shift register
+static uint8_t uspiBusy = 0;
+static uint64_t uspiShiftEnd = 0;
+static uint8_t uspiBuffer = 0;			// Transmit buffer behind UDR0
+static uint8_t uspiBuffered = 0;
+static uint8_t uspiRx[2];				// Receive FIFO
+static uint8_t uspiRxCount = 0;
+static uint8_t uspiComplete = 0;		// TXC0
+static uint8_t uspiExposed = 0xFF;		// Value left in UDR0 at its last access
+static uint8_t uspiPending = 0;			// UDR0 access not classified yet
+static uint8_t uspiRxSeen = 0;			// Last UCSR0A read showed RXC0
+static uint8_t uspiStatusPolls = 0;		// UCSR0A reads since the last UDR0 access
+
+hostTwiStats_t hostTwiStats;
+
+static const hostTwiSlave_t * twiSlaves[HOST_TWI_MAX_SLAVES];
+static const hostTwiSlave_t * twiTarget = 0;	// Slave addressed in the current transfer
+static uint8_t twiControl = 0;			// Last value written to TWCR
+static uint8_t twiInterruptFlag = 0;	// Hardware TWINT flag
+static uint8_t twiBusOwned = 0;			// START issued and no STOP yet
+static uint8_t twiReading = 0;			// SLA+R accepted
+static uint8_t twiAddressPhase = 0;		// Next byte in TWDR is SLA+R/W
+static uint8_t inTwiVector = 0;
+
+hostAdcStats_t hostAdcStats;
+
+static hostAdcSource_t adcSource = 0;
+static uint16_t timer0Prescaler = 0;	// 0: timer stopped
+static uint64_t timer0Base = 0;			// Cycle at which TCNT0 was last zero
+static uint64_t timer0Overflow = HOST_NEVER;
+static uint16_t timer1Prescaler = 0;
+static uint64_t timer1Base = 0;			// Cycle at which TCNT1 was last zero
+static uint16_t timer1Count = 0;		// Last count stored in TCNT1 by the model
+static uint64_t timer1Overflow = HOST_NEVER;
+static uint16_t timer2Prescaler = 0;
+static uint64_t timer2Base = 0;			// Cycle at which TCNT2 was last zero
+static uint64_t timer2Overflow = HOST_NEVER;
+static uint8_t adcConverting = 0;
+static uint8_t adcFirst = 1;			// First conversion after ADEN takes 25 ADC clocks
+static uint8_t adcChannel = 0;			// MUX latched at the start of the conversion
+static uint64_t adcDone = HOST_NEVER;
+static uint64_t powerFail = HOST_NEVER;	// PD2 falls at this cycle
+static uint8_t int0Flag = 0;			// INTF0 (EIFR is write-one-to-clear, kept out of the I/O space)
+static uint8_t ioRunning = 0;
+
+// -----------------------------------------------------------------------------
+// Interrupt controller --------------------------------------------------------
+
+static void hostTwiService(void);
+
+void hostIsrCall(void (*vector)(void))
+{
+	uint8_t sreg = SREG;
+
+	SREG = sreg & ~(1 << SREG_I);		// Hardware clears I on entry
+	vector();
+	SREG |= sreg & (1 << SREG_I);		// reti
+}
+
+uint8_t hostInterruptsEnabled(void)
+{
+	return (SREG >> SREG_I) & 1;
+}
+
+void hostInterruptsEnable(void)
+{
+	SREG |= (1 << SREG_I);
+	hostTwiService();					// Level-triggered sources still pending
+	hostIoRun(hostClockCycles());
+}
+
+// Vectors that the firmware under test does not implement
+__attribute__((weak)) void INT0_vect(void) {}
+__attribute__((weak)) void TIMER0_OVF_vect(void) {}
+__attribute__((weak)) void TIMER1_OVF_vect(void) {}
+__attribute__((weak)) void TIMER2_OVF_vect(void) {}
+__attribute__((weak)) void SPI_STC_vect(void) {}
+__attribute__((weak)) void USART_RX_vect(void) {}
+__attribute__((weak)) void USART_UDRE_vect(void) {}
+__attribute__((weak)) void USART_TX_vect(void) {}
+__attribute__((weak)) void ADC_vect(void) {}
+__attribute__((weak)) void TWI_vect(void) {}
+
+// -----------------------------------------------------------------------------
+// Serial Peripheral Interface -------------------------------------------------
+
+void hostSpiAttach(hostSpiDevice_t device)
+{
+	spiDevice = device;
+}
+
+uint8_t hostSpiClockDivider(void)
+{
+	static const uint8_t dividers[4] = {4, 16, 64, 128};
+	uint8_t divider = dividers[hostIoSpace[0x4C] & 0x03];
+
+	if(hostIoSpace[0x4D] & (1 << SPI2X))
+		divider /= 2;
+	return divider;
+}
+
+/* For the device models: SCK of the byte they are called for */
+uint16_t hostSpiSckDivider(void)
+{
+	return spiSck;
+}
+
+static void spiTransfer(void)
+{
+	uint8_t mosi = hostIoSpace[0x4E];
+	uint8_t selected = !(hostIoSpace[0x25] & (1 << PB2));	// Card CS on PB2
+	uint16_t cycles = 8 * hostSpiClockDivider();
+
+	hostClockAdvance(cycles);
+	hostSpiStats.bytes++;
+	hostSpiStats.cycles += cycles;
+	spiSck = hostSpiClockDivider();
+	spiReceived = spiDevice ? spiDevice(mosi, selected) : 0xFF;
+	hostIoSpace[0x4E] = spiReceived;
+	spiFlag = 1;
+	spiWrites = 0;
+	spiMaybeWrite = 0;
+	spiIdlePolls = 0;
+}
+
+/* A transfer starts on the first SPSR poll after SPDR was written. Writing the
+ * byte that is already latched cannot be told apart from a read, so that case
+ * starts on the second poll: on the device an idle SPSR poll loop never ends */
+volatile uint8_t * hostSpiStatusRegister(void)
+{
+	uint8_t spcr = hostIoSpace[0x4C];
+
+	if(!spiFlag && (spcr & (1 << SPE)) && (spcr & (1 << MSTR))){
+		if(spiWrites || (hostIoSpace[0x4E] != spiReceived))
+			spiTransfer();
+		else if(spiMaybeWrite && (++spiIdlePolls >= 2))
+			spiTransfer();
+	}
+	hostIoSpace[0x4D] = (hostIoSpace[0x4D] & (1 << SPI2X)) | (spiFlag << SPIF);
+	if(spiFlag)
+		spiFlagSeen = 1;
+	return &hostIoSpace[0x4D];
+}
+
+volatile uint8_t * hostSpiDataRegister(void)
+{
+	if(spiFlag && spiFlagSeen){				// Reading SPSR then accessing SPDR clears SPIF
+		spiFlag = 0;
+		spiFlagSeen = 0;
+		spiMaybeWrite = 1;
+		spiIdlePolls = 0;
+	}else{
+		spiWrites = 1;
+	}
+	return &hostIoSpace[0x4E];
+}
+
+// -----------------------------------------------------------------------------
+// USART0 in Master SPI mode ---------------------------------------------------
+
+/* UDR0 is both the transmit buffer (write) and the receive FIFO (read). An
+ * access is classified on the next UDR0 or UCSR0A access: it was a write if
+ * UDR0 no longer holds the value the model left there, or if the UCSR0A read
+ * before it did not show RXC0; otherwise it was a read. The firmware reads
+ * UDR0 only after seeing RXC0 and never writes between that poll and the
+ * read, which keeps the rule unambiguous. The clock moves to the end of the
+ * byte being shifted when UCSR0A is read with the transmit buffer full, or
+ * polled twice with nothing received */
+
+static uint8_t uspiEnabled(void)
+{
+	return ((hostIoSpace[0xC2] & ((1 << UMSEL01) | (1 << UMSEL00))) == ((1 << UMSEL01) | (1 << UMSEL00)))
+		&& (hostIoSpace[0xC1] & (1 << TXEN0));
+}
+
+static uint32_t uspiByteCycles(void)
+{
+	return 16 * (((hostIoSpace[0xC4] | (hostIoSpace[0xC5] << 8)) & 0x0FFF) + 1);
+}
+
+static void uspiSync(void)
+{
+	uint64_t now = hostClockCycles();
+	uint8_t selected;
+	uint8_t miso;
+
+	while(uspiBusy && (now >= uspiShiftEnd)){
+		selected = !(hostIoSpace[0x25] & (1 << PB2));		// Card CS on PB2
+		spiSck = uspiByteCycles() / 8;
+		miso = spiDevice ? spiDevice(uspiShifting, selected) : 0xFF;
+		hostSpiStats.bytes++;
+		hostSpiStats.cycles += uspiByteCycles();
+		if(uspiRxCount < 2)
+			uspiRx[uspiRxCount++] = miso;				// Otherwise data overrun
+		if(uspiBuffered){
+			uspiShifting = uspiBuffer;
+			uspiBuffered = 0;
+			uspiShiftEnd += uspiByteCycles();
+		}else{
+			uspiBusy = 0;
+			uspiComplete = 1;
+		}
+	}
+}
+
+static void uspiWrite(uint8_t data)
+{
+	uspiSync();
+	uspiComplete = 0;
+	if(!uspiBusy){
+		uspiShifting = data;
+		uspiBusy = 1;
+		uspiShiftEnd = hostClockCycles() + uspiByteCycles();
+	}else if(!uspiBuffered){
+		uspiBuffer = data;
+		uspiBuffered = 1;
+	}									// Written while UDRE0 was clear: lost
+}
+
+static void uspiResolve(void)
+{
+	uint8_t value = hostIoSpace[0xC6];
+
+	if(!uspiPending)
+		return;
+	uspiPending = 0;
+	if((value != uspiExposed) || !uspiRxSeen){
+		uspiWrite(value);
+	}else if(uspiRxCount){
+		uspiRx[0] = uspiRx[1];
+		uspiRxCount--;
+	}
+	uspiRxSeen = 0;
+}
+
+volatile uint8_t * hostUsartStatusRegister(void)
+{
+	if(!uspiEnabled())
+		return &hostIoSpace[0xC0];
+	uspiResolve();
+	uspiSync();
+	if(uspiBusy && (uspiBuffered || (!uspiRxCount && uspiStatusPolls))){
+		hostClockAdvance(uspiShiftEnd - hostClockCycles());
+		uspiSync();
+	}
+	hostIoSpace[0xC0] = (uspiRxCount ? (1 << RXC0) : 0) | (uspiComplete ? (1 << TXC0) : 0) | (uspiBuffered ? 0 : (1 << UDRE0));
+	uspiRxSeen = (uspiRxCount != 0);
+	if(uspiStatusPolls < 0xFF)
+		uspiStatusPolls++;
+	return &hostIoSpace[0xC0];
+}
+
+volatile uint8_t * hostUsartDataRegister(void)
+{
+	if(!uspiEnabled())
+		return &hostIoSpace[0xC6];
+	uspiResolve();
+	uspiSync();
+	if(uspiRxCount)
+		uspiExposed = uspiRx[0];
+	hostIoSpace[0xC6] = uspiExposed;
+	uspiPending = 1;
+	uspiStatusPolls = 0;
+	return &hostIoSpace[0xC6];
+}
+
+// -----------------------------------------------------------------------------
+// Two Wire Interface ----------------------------------------------------------
+
+void hostTwiAttach(const hostTwiSlave_t * slave)
+{
+	uint8_t i;
+
+	for(i = 0; i < HOST_TWI_MAX_SLAVES; i++){
+		if(!twiSlaves[i]){
+			twiSlaves[i] = slave;
+			return;
+		}
+	}
+}
+
+/* SCL period from TWBR and the TWPS prescaler bits of TWSR */
+uint32_t hostTwiSclCycles(void)
+{
+	return 16 + 2UL * hostIoSpace[0xB8] * (1UL << (2 * (hostIoSpace[0xB9] & 0x03)));
+}
+
+static void twiBusTime(uint8_t sclPeriods)
+{
+	uint32_t cycles = sclPeriods * hostTwiSclCycles();
+
+	hostTwiStats.cycles += cycles;
+	hostClockAdvance(cycles);
+}
+
+static void twiSetStatus(uint8_t status)
+{
+	hostIoSpace[0xB9] = (status & 0xF8) | (hostIoSpace[0xB9] & 0x03);
+	twiInterruptFlag = 1;
+}
+
+static void twiEndTransfer(void)
+{
+	if(twiTarget && twiTarget->stop)
+		twiTarget->stop();
+	twiTarget = 0;
+}
+
+static void twiAddress(uint8_t sla)
+{
+	uint8_t i;
+	uint8_t ack = 0;
+
+	twiBusTime(9);
+	hostTwiStats.bytes++;
+	hostTwiStats.transfers++;
+	twiReading = sla & 1;
+	twiTarget = 0;
+	for(i = 0; i < HOST_TWI_MAX_SLAVES; i++){
+		if(twiSlaves[i] && (twiSlaves[i]->address == (sla >> 1))){
+			ack = twiSlaves[i]->start ? twiSlaves[i]->start(twiReading) : 1;
+			if(ack)
+				twiTarget = twiSlaves[i];
+			break;
+		}
+	}
+	if(twiReading)
+		twiSetStatus(ack ? 0x40 : 0x48);
+	else
+		twiSetStatus(ack ? 0x18 : 0x20);
+}
+
+static void twiExecute(void)
+{
+	uint8_t ack;
+
+	if(twiControl & (1 << TWSTA)){				// (Repeated) START
+		twiEndTransfer();
+		twiBusTime(1);
+		twiSetStatus(twiBusOwned ? 0x10 : 0x08);
+		twiBusOwned = 1;
+		twiReading = 0;
+		twiAddressPhase = 1;
+	}else if(twiControl & (1 << TWSTO)){		// STOP: TWINT is not set
+		twiEndTransfer();
+		twiBusTime(1);
+		twiControl &= ~(1 << TWSTO);
+		twiBusOwned = 0;
+		twiReading = 0;
+		hostIoSpace[0xB9] = 0xF8 | (hostIoSpace[0xB9] & 0x03);
+	}else if(twiAddressPhase){					// SLA+R/W
+		twiAddressPhase = 0;
+		twiAddress(hostIoSpace[0xBB]);
+	}else if(twiReading){						// Master receiver, nobody drives SDA without a slave
+		ack = (twiControl & (1 << TWEA)) ? 1 : 0;
+		twiBusTime(9);
+		hostTwiStats.bytes++;
+		hostIoSpace[0xBB] = (twiTarget && twiTarget->read) ? twiTarget->read(ack) : 0xFF;
+		twiSetStatus(ack ? 0x50 : 0x58);
+	}else if(twiBusOwned){						// Master transmitter
+		twiBusTime(9);
+		hostTwiStats.bytes++;
+		ack = (twiTarget && twiTarget->write) ? twiTarget->write(hostIoSpace[0xBB]) : 0;
+		twiSetStatus(ack ? 0x28 : 0x30);
+	}
+}
+
+static void hostTwiService(void)
+{
+	uint8_t raw;
+
+	for(;;){
+		raw = hostIoSpace[0xBC];
+		if(!(raw & (1 << HOST_TWCR_CANARY))){		// Firmware wrote TWCR
+			twiControl = raw;
+			if((raw & (1 << TWINT)) && (raw & (1 << TWEN))){
+				twiInterruptFlag = 0;				// Writing one clears TWINT and starts the next action
+				twiExecute();
+			}
+			if(!(raw & (1 << TWEN))){
+				twiInterruptFlag = 0;
+				twiBusOwned = 0;
+			}
+		}
+		hostIoSpace[0xBC] = (twiControl & ~((1 << TWINT) | (1 << HOST_TWCR_CANARY))) | (twiInterruptFlag << TWINT) | (1 << HOST_TWCR_CANARY);
+
+		// The vector writes TWCR again, which is consumed on the next pass
+		if(!twiInterruptFlag || !(twiControl & (1 << TWIE)) || !hostInterruptsEnabled() || inTwiVector)
+			break;
+		inTwiVector = 1;
+		hostIsrCall(TWI_vect);
+		inTwiVector = 0;
+	}
+}
+
+volatile uint8_t * hostTwiControlRegister(void)
+{
+	hostTwiService();
+	return &hostIoSpace[0xBC];
+}
+
+// -----------------------------------------------------------------------------
+// Timer/counter 0 -------------------------------------------------------------
+
+/* Normal mode only, which is what sensor.c uses to trigger the ADC */
+static void timer0Sync(uint64_t now)
+{
+	static const uint16_t prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+	uint16_t prescaler = prescalers[hostIoSpace[0x45] & 0x07];
+	uint8_t count = hostIoSpace[0x46];
+
+	if(prescaler != timer0Prescaler){	// TCCR0B was written: restart from the current count
+		timer0Prescaler = prescaler;
+		timer0Base = now - (uint64_t)count * prescaler;
+		timer0Overflow = prescaler ? (timer0Base + 256UL * prescaler) : HOST_NEVER;
+	}
+	if(timer0Prescaler)
+		hostIoSpace[0x46] = (uint8_t)((now - timer0Base) / timer0Prescaler);
+}
+
+// -----------------------------------------------------------------------------
+// Timer/counter 1 -------------------------------------------------------------
+
+/* Normal mode free-running counter. A TCNT1 value that differs from the last
+ * one the model stored was written by the firmware and restarts the count */
+static void timer1Sync(uint64_t now)
+{
+	static const uint16_t prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+	uint16_t prescaler = prescalers[hostIoSpace[0x81] & 0x07];
+	uint16_t count = hostIoSpace[0x84] | (hostIoSpace[0x85] << 8);
+	uint64_t ticks;
+
+	if((prescaler != timer1Prescaler) || (count != timer1Count)){
+		timer1Prescaler = prescaler;
+		timer1Base = now - (uint64_t)count * prescaler;
+	}
+	if(!timer1Prescaler){
+		timer1Count = count;
+		timer1Overflow = HOST_NEVER;
+		return;
+	}
+	ticks = (now - timer1Base) / timer1Prescaler;
+	if(ticks >= 0x10000){
+		hostIoSpace[0x36] |= (1 << TOV1);
+		timer1Base += (ticks & ~0xFFFFULL) * timer1Prescaler;
+	}
+	timer1Count = (uint16_t)ticks;
+	hostIoSpace[0x84] = (uint8_t)timer1Count;
+	hostIoSpace[0x85] = (uint8_t)(timer1Count >> 8);
+	timer1Overflow = (hostIoSpace[0x6F] & (1 << TOIE1)) ? (timer1Base + 0x10000ULL * timer1Prescaler) : HOST_NEVER;
+}
+
+// -----------------------------------------------------------------------------
+// Timer/counter 2 -------------------------------------------------------------
+
+/* Normal mode free-running counter read by the timeouts of mmc.c, with the
+ * overflow interrupt that counts the wraps during a non-blocking write.
+ * TIFR2 is plain memory, so writing TOV2 to clear it sets it instead: at
+ * most one extra wrap, 1.024 ms at 16 MHz */
+static void timer2Sync(uint64_t now)
+{
+	static const uint16_t prescalers[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+	uint16_t prescaler = prescalers[hostIoSpace[0xB1] & 0x07];
+	uint8_t count = hostIoSpace[0xB2];
+	uint64_t ticks;
+
+	if(prescaler != timer2Prescaler){	// TCCR2B was written: restart from the current count
+		timer2Prescaler = prescaler;
+		timer2Base = now - (uint64_t)count * prescaler;
+	}
+	if(!timer2Prescaler){
+		timer2Overflow = HOST_NEVER;
+		return;
+	}
+	ticks = (now - timer2Base) / timer2Prescaler;
+	if(ticks >= 0x100){
+		hostIoSpace[0x37] |= (1 << TOV2);
+		timer2Base += (ticks & ~0xFFULL) * timer2Prescaler;
+	}
+	hostIoSpace[0xB2] = (uint8_t)ticks;
+	timer2Overflow = (hostIoSpace[0x70] & (1 << TOIE2)) ? (timer2Base + 0x100ULL * timer2Prescaler) : HOST_NEVER;
+}
+
+// -----------------------------------------------------------------------------
+// Analog/Digital Converter ----------------------------------------------------
+
+void hostAdcAttach(hostAdcSource_t source)
+{
+	adcSource = source;
+}
+
+static void adcStart(uint64_t now)
+{
+	uint8_t prescaler = 1 << (hostIoSpace[0x7A] & 0x07);
+
+	if(prescaler < 2)
+		prescaler = 2;
+	adcConverting = 1;
+	adcChannel = hostIoSpace[0x7C] & 0x0F;
+	adcDone = now + (adcFirst ? (25UL * prescaler) : ((27UL * prescaler) / 2));
+	adcFirst = 0;
+	hostIoSpace[0x7A] |= (1 << ADSC);
+}
+
+static void adcTrigger(uint64_t now)
+{
+	uint8_t sra = hostIoSpace[0x7A];
+
+	if(!(sra & (1 << ADEN)) || !(sra & (1 << ADATE)) || ((hostIoSpace[0x7B] & 0x07) != 0x04))
+		return;
+	if(adcConverting)
+		hostAdcStats.missedTriggers++;
+	else
+		adcStart(now);
+}
+
+static void adcComplete(uint64_t at)
+{
+	uint16_t value = adcSource ? adcSource(adcChannel) : 0;
+
+	if(value > 0x3FF)
+		value = 0x3FF;
+	if(hostIoSpace[0x7C] & (1 << ADLAR))
+		value <<= 6;
+	hostIoSpace[0x78] = (uint8_t)value;
+	hostIoSpace[0x79] = (uint8_t)(value >> 8);
+	hostIoSpace[0x7A] = (hostIoSpace[0x7A] & ~(1 << ADSC)) | (1 << ADIF);
+	hostAdcStats.conversions++;
+	adcConverting = 0;
+	adcDone = HOST_NEVER;
+	if((hostIoSpace[0x7A] & (1 << ADATE)) && !(hostIoSpace[0x7B] & 0x07))
+		adcStart(at);					// Free running mode
+}
+
+static void adcSync(uint64_t now)
+{
+	uint8_t sra = hostIoSpace[0x7A];
+
+	if(!(sra & (1 << ADEN))){
+		adcConverting = 0;
+		adcFirst = 1;
+		adcDone = HOST_NEVER;
+		return;
+	}
+	if(!adcConverting && (sra & (1 << ADSC)))	// Firmware wrote ADSC
+		adcStart(now);
+}
+
+// -----------------------------------------------------------------------------
+// Event dispatch --------------------------------------------------------------
+
+/* Fires the peripheral events due at now, delivers the pending vectors in
+ * hardware priority order and returns the cycle of the next event. Called by
+ * the virtual clock on every advance */
+uint64_t hostIoRun(uint64_t now)
+{
+	uint64_t next;
+
+	if(ioRunning)
+		return now;
+	ioRunning = 1;
+
+	timer0Sync(now);
+	timer1Sync(now);
+	timer2Sync(now);
+	adcSync(now);
+	while(timer0Overflow <= now){
+		timer0Base = timer0Overflow;
+		timer0Overflow += 256UL * timer0Prescaler;
+		hostAdcStats.timer0Overflows++;
+		if(!(hostIoSpace[0x35] & (1 << TOV0))){	// The trigger is the rising edge of TOV0
+			hostIoSpace[0x35] |= (1 << TOV0);
+			adcTrigger(timer0Base);
+		}
+		hostIoSpace[0x46] = (uint8_t)((now - timer0Base) / timer0Prescaler);
+	}
+	if(adcDone <= now)
+		adcComplete(adcDone);
+	if(powerFail <= now){
+		powerFail = HOST_NEVER;
+		hostIoSpace[0x29] &= ~(1 << PD2);
+		if((hostIoSpace[0x69] & ((1 << ISC01) | (1 << ISC00))) == (1 << ISC01))	// Falling edge
+			int0Flag = 1;
+	}
+
+	if(hostInterruptsEnabled()){
+		if(int0Flag && (hostIoSpace[0x3D] & (1 << INT0))){
+			int0Flag = 0;				// Executing the vector clears INTF0
+			hostIsrCall(INT0_vect);
+		}
+		if((hostIoSpace[0x36] & (1 << TOV1)) && (hostIoSpace[0x6F] & (1 << TOIE1))){
+			hostIoSpace[0x36] &= ~(1 << TOV1);
+			hostIsrCall(TIMER1_OVF_vect);
+		}
+		if((hostIoSpace[0x37] & (1 << TOV2)) && (hostIoSpace[0x70] & (1 << TOIE2))){
+			hostIoSpace[0x37] &= ~(1 << TOV2);
+			hostIsrCall(TIMER2_OVF_vect);
+		}
+		if((hostIoSpace[0x35] & (1 << TOV0)) && (hostIoSpace[0x6E] & (1 << TOIE0))){
+			hostIoSpace[0x35] &= ~(1 << TOV0);
+			hostIsrCall(TIMER0_OVF_vect);
+		}
+		if((hostIoSpace[0x7A] & (1 << ADIF)) && (hostIoSpace[0x7A] & (1 << ADIE))){
+			hostIoSpace[0x7A] &= ~(1 << ADIF);
+			hostIsrCall(ADC_vect);
+		}
+	}
+
+	next = (timer0Overflow < adcDone) ? timer0Overflow : adcDone;
+	if(timer1Overflow < next)
+		next = timer1Overflow;
+	if(timer2Overflow < next)
+		next = timer2Overflow;
+	if(powerFail < next)
+		next = powerFail;
+	ioRunning = 0;
+	return next;
+}
+
+// -----------------------------------------------------------------------------
+// Power-fail input ------------------------------------------------------------
+
+/* PD2 (INT0) goes low at cycle and stays low, as a supply supervisor does
+ * before the supply collapses. Only the falling edge sense is modelled */
+void hostPowerFailAt(uint64_t cycle)
+{
+	powerFail = cycle;
+}
@@ -0,0 +1,76 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			hostio.h
+ * Module:			Emulated I/O space and interrupt controller
+ * Purpose:			Holds the ATmega328P register file used by <avr/io.h>,
+ *					dispatches interrupt vectors and runs the peripheral models
+ *					that react to register accesses
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOSTIO_H
+#define __HOSTIO_H
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define HOST_TWCR_CANARY	1		// TWCR bit 1 is reserved and reads as zero on the device
+#define HOST_TWI_MAX_SLAVES	4
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef uint8_t (*hostSpiDevice_t)(uint8_t mosi, uint8_t selected);
+
+typedef uint16_t (*hostAdcSource_t)(uint8_t channel);
+
+typedef struct hostTwiSlave_t{
+	uint8_t	address;						// 7-bit slave address
+	uint8_t	(*start)(uint8_t readWrite);	// Addressed after a (repeated) START; returns ACK
+	uint8_t	(*write)(uint8_t data);			// Byte from the master; returns ACK
+	uint8_t	(*read)(uint8_t ack);			// Byte to the master, ack tells if the master ACKs it
+	void	(*stop)(void);					// STOP or repeated START ends the transfer
+} hostTwiSlave_t;
+
+typedef struct hostTwiStats_t{
+	uint64_t	transfers;			// Addressed transfers (SLA+R/W)
+	uint64_t	bytes;				// Bytes on the bus, address bytes included
+	uint64_t	cycles;				// CPU cycles of bus time (START, bytes, STOP)
+} hostTwiStats_t;
+
+typedef struct hostAdcStats_t{
+	uint64_t	timer0Overflows;	// Timer0 overflows (ADC auto trigger source)
+	uint64_t	conversions;		// Completed ADC conversions
+	uint64_t	missedTriggers;		// Triggers lost while a conversion was running
+} hostAdcStats_t;
+
+typedef struct hostSpiStats_t{
+	uint64_t	bytes;				// Bytes shifted by the SPI peripheral
+	uint64_t	cycles;				// CPU cycles spent shifting them
+} hostSpiStats_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+extern hostSpiStats_t hostSpiStats;
+extern hostTwiStats_t hostTwiStats;
+extern hostAdcStats_t hostAdcStats;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+void	hostIsrCall(void (*vector)(void));
+uint8_t	hostInterruptsEnabled(void);
+uint64_t hostIoRun(uint64_t now);
+void	hostSpiAttach(hostSpiDevice_t device);
+uint8_t	hostSpiClockDivider(void);
+uint16_t hostSpiSckDivider(void);
+void	hostTwiAttach(const hostTwiSlave_t * slave);
+uint32_t hostTwiSclCycles(void);
+void	hostAdcAttach(hostAdcSource_t source);
+void	hostPowerFailAt(uint64_t cycle);
+
+#endif
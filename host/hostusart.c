@@ -0,0 +1,65 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			hostusart.c
+ * Module:			USART0 subset of the ATmega328 basic interface
+ * Purpose:			Stands in for the USART functions of ATmega328.c and for the
+ *					software UART (softuart.c) used by the firmware. The debug
+ *					console is the host's stdout
+ * -------------------------------------------------------------------------- */
+
+#include "ATmega328.h"
+#include "softuart.h"
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+resultValue_t usartConfig(usartMode_t mode, usartBaudRate_t baudRate, usartDataBits_t dataBits, usartParity_t parity, usartStopBits_t stopBits)
+{
+	(void)dataBits;
+	(void)parity;
+	(void)stopBits;
+
+	if((baudRate != USART_BAUD_NO_CHANGE) && (mode == USART_MODE_ASYNCHRONOUS)){
+		UBRR0H = 0x0F & ((F_CPU / 16 / baudRate - 1) >> 8);
+		UBRR0L = 0xFF & (F_CPU / 16 / baudRate - 1);
+	}
+	return RESULT_OK;
+}
+
+resultValue_t usartEnableReceiver(void)
+{
+	setBit(UCSR0B, RXEN0);
+	return RESULT_OK;
+}
+
+resultValue_t usartEnableTransmitter(void)
+{
+	setBit(UCSR0B, TXEN0);
+	return RESULT_OK;
+}
+
+resultValue_t usartStdio(void)
+{
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	return RESULT_OK;
+}
+
+resultValue_t usartTransmit(int8 data)
+{
+	putchar(data);
+	return RESULT_OK;
+}
+
+void softUartInit(void)
+{
+}
+
+void softUartTransmit(char data)
+{
+	putchar(data);
+}
+
+void softUartStdio(void)
+{
+	setvbuf(stdout, NULL, _IOLBF, 0);
+}
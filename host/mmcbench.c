@@ -0,0 +1,205 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			mmcbench.c
+ * Module:			SD card write path benchmark
+ * Purpose:			Times sequential sector writes through mmc.c on the SD card
+ *					model: one CMD24 per sector, the CMD25 write session, the
+ *					session pre-erased with ACMD23 and the non-blocking write
+ *					polled until done, and checks the sectors read back and the
+ *					guard of a pre-erased session closed early. Reports
+ *					simulated milliseconds as CSV, with the mmc_write_poll()
+ *					calls per sector of the non-blocking write
+ * Usage:			mmcbench [-n sectors] [-p us]
+ *					-n	sectors written by each workload (default 64)
+ *					-p	simulated time between two mmc_write_poll() calls of
+ *						the non-blocking write (default 0)
+ *					The image comes from SD_IMAGE (default "sd.mmc"); the
+ *					workloads write raw sectors near its end, outside the file
+ *					system, so run it on a copy (make mmcbench does)
+ * -------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <avr/interrupt.h>
+#include "diskio.h"
+#include "hostclock.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define BENCH_SECTOR_SIZE		512
+#define BENCH_MAX_SECTORS		1024
+#define BENCH_TAIL				(8 * BENCH_MAX_SECTORS)	// Sectors kept from the end of the image
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef enum benchMode_t{
+	BENCH_CMD24 = 0,
+	BENCH_SESSION,
+	BENCH_PRE_ERASED,
+	BENCH_NON_BLOCKING,
+	BENCH_MODES
+} benchMode_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+static BYTE sector[BENCH_SECTOR_SIZE];
+
+static const char * const modeNames[BENCH_MODES] = {
+	"cmd24", "session", "session_acmd23", "non_blocking"
+};
+
+static uint32_t polls;
+static uint32_t pollUs = 0;
+
+// -----------------------------------------------------------------------------
+// Private functions -----------------------------------------------------------
+
+static double elapsedMs(uint64_t start)
+{
+	return (hostClockCycles() - start) / (F_CPU / 1000.0);
+}
+
+static void fillSector(DWORD lba)
+{
+	memset(sector, (BYTE)lba, BENCH_SECTOR_SIZE);
+	memcpy(sector, &lba, sizeof(lba));
+}
+
+/* The caller does its own work for pollUs between the polls */
+static DRESULT writeNonBlocking(DWORD lba)
+{
+	WRSTAT status;
+
+	if(mmc_write_start(sector, lba) != RES_OK)
+		return RES_ERROR;
+	for(;;){
+		status = mmc_write_poll();
+		polls++;
+		if(status != WR_BUSY)
+			break;
+		hostClockDelayUs(pollUs);
+	}
+	return (status == WR_DONE) ? RES_OK : RES_ERROR;
+}
+
+static DRESULT runWorkload(benchMode_t mode, DWORD base, uint16_t count)
+{
+	DRESULT result = RES_OK;
+	uint16_t i;
+
+	if(mode == BENCH_NON_BLOCKING){
+		for(i = 0; (i < count) && (result == RES_OK); i++){
+			fillSector(base + i);
+			result = writeNonBlocking(base + i);
+		}
+		return result;
+	}
+	if(mode != BENCH_CMD24)
+		result = mmc_write_open(base, (mode == BENCH_PRE_ERASED) ? count : 0);
+	for(i = 0; (i < count) && (result == RES_OK); i++){
+		fillSector(base + i);
+		result = disk_write(0, sector, base + i, 1);
+	}
+	if(mmc_write_close() != RES_OK)
+		result = RES_ERROR;
+	if(disk_ioctl(0, CTRL_SYNC, 0) != RES_OK)
+		result = RES_ERROR;
+	return result;
+}
+
+static uint16_t verify(DWORD base, uint16_t count)
+{
+	BYTE expected[BENCH_SECTOR_SIZE];
+	uint16_t bad = 0;
+	uint16_t i;
+
+	for(i = 0; i < count; i++){
+		fillSector(base + i);
+		memcpy(expected, sector, BENCH_SECTOR_SIZE);
+		if((disk_read(0, sector, base + i, 1) != RES_OK) || memcmp(sector, expected, BENCH_SECTOR_SIZE))
+			bad++;
+	}
+	return bad;
+}
+
+/* A pre-erased session must be filled: other accesses fail and leave it open */
+static uint8_t checkGuard(DWORD base)
+{
+	uint8_t ok;
+
+	if(mmc_write_open(base, 4) != RES_OK)
+		return 0;
+	fillSector(base);
+	ok = (disk_write(0, sector, base, 1) == RES_OK);
+	ok &= (disk_read(0, sector, base, 1) == RES_ERROR);			// Refused
+	ok &= (disk_write(0, sector, base + 8, 1) == RES_ERROR);	// Not sequential: refused
+	fillSector(base + 1);
+	ok &= (disk_write(0, sector, base + 1, 1) == RES_OK);		// Still open
+	ok &= (mmc_write_close() == RES_ERROR);						// Two sectors never written
+	ok &= (disk_read(0, sector, base, 1) == RES_OK);
+	return ok;
+}
+
+static void usage(const char * program)
+{
+	fprintf(stderr, "usage: %s [-n sectors] [-p us]\n", program);
+	exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+// Main function ---------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+	uint16_t count = 64;
+	DWORD sectors, base;
+	DRESULT result;
+	uint64_t start;
+	double ms;
+	uint8_t mode;
+	int option;
+
+	while((option = getopt(argc, argv, "n:p:")) != -1){
+		switch(option){
+		case 'n':
+			count = (uint16_t)strtoul(optarg, 0, 0);
+			break;
+		case 'p':
+			pollUs = (uint32_t)strtoul(optarg, 0, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if(!count || (count > BENCH_MAX_SECTORS))
+		usage(argv[0]);
+
+	sei();									// As in main(): the non-blocking write counts Timer2 wraps
+	if(disk_initialize(0) & STA_NOINIT){
+		fprintf(stderr, "mmcbench: card not initialized\n");
+		return EXIT_FAILURE;
+	}
+	if((disk_ioctl(0, GET_SECTOR_COUNT, &sectors) != RES_OK) || (sectors < BENCH_TAIL)){
+		fprintf(stderr, "mmcbench: image too small\n");
+		return EXIT_FAILURE;
+	}
+	base = sectors - BENCH_TAIL;
+
+	printf("mode,sectors,result,ms,ms_per_sector,bad_sectors,polls_per_sector\n");
+	for(mode = 0; mode < BENCH_MODES; mode++, base += BENCH_MAX_SECTORS){
+		polls = 0;
+		start = hostClockCycles();
+		result = runWorkload(mode, base, count);
+		ms = elapsedMs(start);
+		printf("%s,%u,%d,%.3f,%.4f,%u,%.1f\n", modeNames[mode], count, result, ms, ms / count, verify(base, count),
+			(double)polls / count);
+	}
+	printf("early close of a pre-erased session refused: %s\n", checkGuard(base) ? "yes" : "NO");
+
+	return 0;
+}
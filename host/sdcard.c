@@ -0,0 +1,653 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			sdcard.c
+ * Module:			SD card model (SPI mode)
+ * Purpose:			Byte-level model of an SD card wired to the SPI peripheral.
+ *					Implements CMD0/8/9/10/12/13/16/17/18/24/25/32/33/38/55/58
+ *					and ACMD13/23/41 over the sd.mmc image, with programmable latency
+ *					and busy times measured on the virtual clock, and counts
+ *					every byte clocked on the bus
+ * Notes:			Linking this module plugs the card into the SPI bus. The
+ *					image path comes from SD_IMAGE (default "sd.mmc"); timings
+ *					can be overridden with SD_HIGH_CAPACITY, SD_INIT_US,
+ *					SD_READ_LATENCY_US, SD_WRITE_BUSY_US, SD_MULTI_BUSY_US,
+ *					SD_STOP_BUSY_US, SD_ERASE_BUSY_US, SD_ERASED_BUSY_US,
+ *					SD_STALL_EVERY, SD_STALL_US, SD_MAX_SCK_KHZ and SD_AU_SIZE
+ * -------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "hostio.h"
+#include "hostclock.h"
+#include "sdcard.h"
+#include "diskmap.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define SDCARD_BLOCK_SIZE		512
+#define SDCARD_NCR				1		// Bytes between a command frame and its response
+
+#define R1_IDLE					0x01
+#define R1_ILLEGAL_COMMAND		0x04
+#define R1_CRC_ERROR			0x08
+#define R1_ERASE_SEQ_ERROR		0x10
+#define R1_ADDRESS_ERROR		0x20
+#define R1_PARAMETER_ERROR		0x40
+
+#define TOKEN_SINGLE			0xFE	// Start block (CMD17/18/24)
+#define TOKEN_MULTI_WRITE		0xFC	// Start block (CMD25)
+#define TOKEN_STOP_TRAN			0xFD	// Stop transmission (CMD25)
+#define DATA_ACCEPTED			0x05
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef enum sdcardState_t{
+	SD_STATE_READY = 0,			// Waiting for a command frame
+	SD_STATE_COMMAND,			// Receiving a command frame
+	SD_STATE_RESPONSE,			// Shifting out queued response bytes
+	SD_STATE_READ_WAIT,			// Nac: data token not available yet
+	SD_STATE_READ_DATA,			// Shifting out a data packet
+	SD_STATE_WRITE_TOKEN,		// Waiting for a data token from the host
+	SD_STATE_WRITE_DATA,		// Receiving a data packet
+	SD_STATE_WRITE_RESPONSE,	// Data response pending
+	SD_STATE_BUSY				// Programming, DO held low
+} sdcardState_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+sdcardConfig_t sdcardConfig = {
+	.highCapacity = 0,			// A 32 MB card is SDSC
+	.initTimeUs = 50000,
+	.readLatencyUs = 200,
+	.writeBusyUs = 800,
+	.multiBusyUs = 150,
+	.stopBusyUs = 400,
+	.eraseBusyUs = 50000,
+	.erasedBusyUs = 250,
+	.stallEvery = 0,
+	.stallUs = 250000,
+	.maxSckKhz = 0,
+	.auSize = 6					// 512 KB
+};
+sdcardStats_t sdcardStats;
+
+static int imageFd = -1;
+static uint32_t imageBlocks = 0;
+
+static sdcardState_t state = SD_STATE_READY;
+static sdcardState_t stateAfterResponse = SD_STATE_READY;
+static uint8_t idle = 1;				// R1 in-idle-state bit
+static uint8_t appCommand = 0;			// Last command was CMD55
+static uint8_t readHeld = 0;			// Deselected between blocks of a multiple read
+static uint8_t frame[6];
+static uint8_t frameLength = 0;
+static uint8_t queue[SDCARD_BLOCK_SIZE + 8];
+static uint16_t queueLength = 0;
+static uint16_t queuePosition = 0;
+static uint8_t block[SDCARD_BLOCK_SIZE + 2];
+static uint16_t blockPosition = 0;
+static uint32_t address = 0;			// Current block number
+static uint8_t multiBlock = 0;
+static uint8_t readSource = 0;			// 0: image, 9: CSD, 10: CID, 13: SD Status
+static uint64_t readyAt = 0;			// Virtual clock cycle when Nac or busy ends
+static uint64_t initStartedAt = 0;
+static uint8_t initStarted = 0;
+static uint32_t preEraseCount = 0;		// ACMD23 argument
+static uint32_t eraseStart = 0;			// CMD32 and CMD33 arguments (block numbers)
+static uint32_t eraseEnd = 0;
+static uint8_t * erased = NULL;			// One bit per block: erased and not written since
+static uint8_t writeErased = 0;			// Block being programmed was erased
+
+// -----------------------------------------------------------------------------
+// Private functions -----------------------------------------------------------
+
+static uint64_t usToCycles(uint32_t us)
+{
+	return (uint64_t)us * HOST_CYCLES_PER_US;
+}
+
+static uint8_t crc7(const uint8_t * data, uint8_t length)
+{
+	uint8_t crc = 0;
+	uint8_t i, j, d;
+
+	for(i = 0; i < length; i++){
+		d = data[i];
+		for(j = 0; j < 8; j++){
+			crc <<= 1;
+			if((d ^ crc) & 0x80)
+				crc ^= 0x09;
+			d <<= 1;
+		}
+	}
+	return (crc << 1) | 1;
+}
+
+static uint16_t crc16(const uint8_t * data, uint16_t length)
+{
+	uint16_t crc = 0;
+	uint16_t i;
+	uint8_t j;
+
+	for(i = 0; i < length; i++){
+		crc ^= (uint16_t)data[i] << 8;
+		for(j = 0; j < 8; j++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	}
+	return crc;
+}
+
+static void getEnvU32(const char * name, uint32_t * value)
+{
+	const char * env = getenv(name);
+
+	if(env)
+		*value = (uint32_t)strtoul(env, NULL, 0);
+}
+
+static void sdcardClose(void)
+{
+	if(imageFd >= 0){
+		fsync(imageFd);
+		close(imageFd);
+		imageFd = -1;
+	}
+	if(getenv("SD_STATS"))
+		sdcardPrintStats(&sdcardStats, stderr);
+}
+
+static void buildCsd(uint8_t * csd)
+{
+	uint32_t cSize;
+
+	memset(csd, 0, 16);
+	if(sdcardConfig.highCapacity){			// CSD version 2.0
+		cSize = imageBlocks / 1024 - 1;
+		csd[0] = 0x40;
+		csd[1] = 0x0E;						// TAAC
+		csd[3] = 0x32;						// TRAN_SPEED: 25 MHz
+		csd[4] = 0x5B;						// CCC
+		csd[5] = 0x59;						// READ_BL_LEN = 9
+		csd[7] = (cSize >> 16) & 0x3F;
+		csd[8] = cSize >> 8;
+		csd[9] = cSize;
+		csd[10] = 0x7F;						// ERASE_BLK_EN, SECTOR_SIZE
+		csd[11] = 0x80;
+		csd[12] = 0x0A;						// R2W_FACTOR, WRITE_BL_LEN = 9
+		csd[13] = 0x40;
+	}else{									// CSD version 1.0, C_SIZE_MULT = 7
+		cSize = imageBlocks / 512 - 1;
+		csd[0] = 0x00;
+		csd[1] = 0x26;						// TAAC
+		csd[3] = 0x32;						// TRAN_SPEED: 25 MHz
+		csd[4] = 0x5F;						// CCC
+		csd[5] = 0x59;						// READ_BL_LEN = 9
+		csd[6] = 0x80 | ((cSize >> 10) & 0x03);
+		csd[7] = cSize >> 2;
+		csd[8] = (cSize << 6) | 0x2D;
+		csd[9] = 0xB4 | 0x03;				// C_SIZE_MULT[2:1] = 3
+		csd[10] = 0x80 | 0x40 | 0x3F;		// C_SIZE_MULT[0] = 1, ERASE_BLK_EN, SECTOR_SIZE
+		csd[11] = 0x80;
+		csd[12] = 0x0A;
+		csd[13] = 0x40;
+	}
+	csd[15] = crc7(csd, 15);
+}
+
+static void buildCid(uint8_t * cid)
+{
+	static const uint8_t model[16] = {0x02, 'T', 'M', 'H', 'O', 'S', 'T', 'S', 0x10, 0x00, 0x00, 0x00, 0x01, 0x01, 0x33, 0x00};
+
+	memcpy(cid, model, 16);
+	cid[15] = crc7(cid, 15);
+}
+
+// SD Status (ACMD13): AU_SIZE, ERASE_SIZE (8 AUs), ERASE_TIMEOUT (2 s) and
+// ERASE_OFFSET (1 s); the remaining fields read as zero
+static void buildSdStatus(uint8_t * status)
+{
+	memset(status, 0, 64);
+	status[10] = (uint8_t)(sdcardConfig.auSize << 4);
+	status[12] = 8;
+	status[13] = (2 << 2) | 1;
+}
+
+static void queueReset(void)
+{
+	queueLength = 0;
+	queuePosition = 0;
+}
+
+static void queuePush(uint8_t data)
+{
+	queue[queueLength++] = data;
+}
+
+static void respond(uint8_t r1, sdcardState_t next)
+{
+	uint8_t i;
+
+	queueReset();
+	for(i = 0; i < SDCARD_NCR; i++)
+		queuePush(0xFF);
+	queuePush(r1 | idle);
+	state = SD_STATE_RESPONSE;
+	stateAfterResponse = next;
+}
+
+static uint8_t addressValid(uint32_t argument)
+{
+	if(!sdcardConfig.highCapacity){
+		if(argument % SDCARD_BLOCK_SIZE)
+			return 0;
+		argument /= SDCARD_BLOCK_SIZE;
+	}
+	if(argument >= imageBlocks)
+		return 0;
+	address = argument;
+	return 1;
+}
+
+static void startRead(void)
+{
+	readyAt = hostClockCycles() + usToCycles(sdcardConfig.readLatencyUs);
+	readHeld = 0;
+	state = SD_STATE_READ_WAIT;
+}
+
+static void loadReadPacket(void)
+{
+	uint16_t length = SDCARD_BLOCK_SIZE;
+	uint16_t crc;
+
+	queueReset();
+	queuePush(TOKEN_SINGLE);
+	if(readSource == 9){
+		buildCsd(&queue[1]);
+		length = 16;
+	}else if(readSource == 10){
+		buildCid(&queue[1]);
+		length = 16;
+	}else if(readSource == 13){
+		buildSdStatus(&queue[1]);
+		length = 64;
+	}else{
+		if(pread(imageFd, &queue[1], SDCARD_BLOCK_SIZE, (off_t)address * SDCARD_BLOCK_SIZE) != SDCARD_BLOCK_SIZE)
+			memset(&queue[1], 0xFF, SDCARD_BLOCK_SIZE);
+		diskmapRead(address, &queue[1], 1);
+		sdcardStats.blocksRead++;
+		address++;
+	}
+	queueLength = length + 1;
+	crc = crc16(&queue[1], length);
+	queuePush(crc >> 8);
+	queuePush(crc);
+	state = SD_STATE_READ_DATA;
+}
+
+static uint8_t blockErased(uint32_t block)
+{
+	return (erased[block >> 3] >> (block & 7)) & 1;
+}
+
+// Erased blocks read as zeros (DATA_STAT_AFTER_ERASE = 0)
+static void eraseBlocks(void)
+{
+	static const uint8_t zeros[SDCARD_BLOCK_SIZE];
+	uint32_t block;
+
+	for(block = eraseStart; block <= eraseEnd; block++){
+		if(pwrite(imageFd, zeros, SDCARD_BLOCK_SIZE, (off_t)block * SDCARD_BLOCK_SIZE) == SDCARD_BLOCK_SIZE)
+			erased[block >> 3] |= 1 << (block & 7);
+	}
+	sdcardStats.blocksErased += eraseEnd - eraseStart + 1;
+}
+
+static void startBusy(uint32_t us)
+{
+	if(sdcardConfig.stallEvery && ((sdcardStats.blocksWritten % sdcardConfig.stallEvery) == 0))
+		us = sdcardConfig.stallUs;
+	readyAt = hostClockCycles() + usToCycles(us);
+	state = SD_STATE_BUSY;
+}
+
+static void executeCommand(void)
+{
+	uint8_t index = frame[0] & 0x3F;
+	uint32_t argument = ((uint32_t)frame[1] << 24) | ((uint32_t)frame[2] << 16) | ((uint32_t)frame[3] << 8) | frame[4];
+	uint8_t app = appCommand;
+	uint8_t ocr[4];
+	uint8_t i;
+
+	appCommand = 0;
+	if(app)
+		sdcardStats.appCommands[index]++;
+	else
+		sdcardStats.commands[index]++;
+
+	// CRC is only checked where SPI mode requires it
+	if(((index == 0) || (index == 8)) && (crc7(frame, 5) != frame[5])){
+		respond(R1_CRC_ERROR, SD_STATE_READY);
+		return;
+	}
+
+	if(app){
+		switch(index){
+		case 41:		// SD_SEND_OP_COND
+			if(!initStarted){
+				initStarted = 1;
+				initStartedAt = hostClockCycles();
+			}
+			if(hostClockCycles() - initStartedAt >= usToCycles(sdcardConfig.initTimeUs))
+				idle = 0;
+			respond(0, SD_STATE_READY);
+			return;
+		case 13:		// SD_STATUS: R2 and a 64-byte data packet
+			readSource = 13;
+			multiBlock = 0;
+			respond(0, SD_STATE_READ_WAIT);
+			queuePush(0x00);
+			return;
+		case 23:		// SET_WR_BLK_ERASE_COUNT
+			preEraseCount = argument & 0x7FFFFF;
+			respond(0, SD_STATE_READY);
+			return;
+		default:
+			break;		// Fall back to the standard command set
+		}
+	}
+
+	switch(index){
+	case 0:			// GO_IDLE_STATE
+		idle = 1;
+		initStarted = 0;
+		multiBlock = 0;
+		respond(0, SD_STATE_READY);
+		break;
+	case 8:			// SEND_IF_COND: R7
+		respond(0, SD_STATE_READY);
+		queuePush(0x00);
+		queuePush(0x00);
+		queuePush((argument >> 8) & 0x0F);
+		queuePush(argument & 0xFF);
+		break;
+	case 9:			// SEND_CSD
+	case 10:		// SEND_CID
+		readSource = index;
+		multiBlock = 0;
+		respond(0, SD_STATE_READ_WAIT);
+		break;
+	case 12:		// STOP_TRANSMISSION: R1b
+		multiBlock = 0;
+		respond(0, SD_STATE_READY);
+		break;
+	case 13:		// SEND_STATUS: R2
+		respond(0, SD_STATE_READY);
+		queuePush(0x00);
+		break;
+	case 16:		// SET_BLOCKLEN
+		respond((argument == SDCARD_BLOCK_SIZE) ? 0 : R1_PARAMETER_ERROR, SD_STATE_READY);
+		break;
+	case 17:		// READ_SINGLE_BLOCK
+	case 18:		// READ_MULTIPLE_BLOCK
+		if(idle || !addressValid(argument)){
+			respond(idle ? R1_ILLEGAL_COMMAND : R1_ADDRESS_ERROR, SD_STATE_READY);
+			break;
+		}
+		readSource = 0;
+		multiBlock = (index == 18);
+		respond(0, SD_STATE_READ_WAIT);
+		break;
+	case 24:		// WRITE_BLOCK
+	case 25:		// WRITE_MULTIPLE_BLOCK
+		if(idle || !addressValid(argument)){
+			respond(idle ? R1_ILLEGAL_COMMAND : R1_ADDRESS_ERROR, SD_STATE_READY);
+			break;
+		}
+		multiBlock = (index == 25);
+		respond(0, SD_STATE_WRITE_TOKEN);
+		break;
+	case 32:		// ERASE_WR_BLK_START_ADDR
+	case 33:		// ERASE_WR_BLK_END_ADDR
+		if(idle || !addressValid(argument)){
+			respond(idle ? R1_ILLEGAL_COMMAND : R1_ADDRESS_ERROR, SD_STATE_READY);
+			break;
+		}
+		if(index == 32)
+			eraseStart = address;
+		else
+			eraseEnd = address;
+		respond(0, SD_STATE_READY);
+		break;
+	case 38:		// ERASE: R1b
+		if(idle || (eraseEnd < eraseStart)){
+			respond(idle ? R1_ILLEGAL_COMMAND : R1_ERASE_SEQ_ERROR, SD_STATE_READY);
+			break;
+		}
+		eraseBlocks();
+		readyAt = hostClockCycles() + usToCycles(sdcardConfig.eraseBusyUs);
+		respond(0, SD_STATE_BUSY);
+		break;
+	case 55:		// APP_CMD
+		appCommand = 1;
+		respond(0, SD_STATE_READY);
+		break;
+	case 58:		// READ_OCR: R3
+		ocr[0] = (idle ? 0x00 : 0x80) | ((sdcardConfig.highCapacity && !idle) ? 0x40 : 0x00);
+		ocr[1] = 0xFF;
+		ocr[2] = 0x80;
+		ocr[3] = 0x00;
+		respond(0, SD_STATE_READY);
+		for(i = 0; i < 4; i++)
+			queuePush(ocr[i]);
+		break;
+	case 1:			// SEND_OP_COND is accepted by SD cards in SPI mode
+		idle = 0;
+		respond(0, SD_STATE_READY);
+		break;
+	default:
+		sdcardStats.illegalCommands++;
+		respond(R1_ILLEGAL_COMMAND, SD_STATE_READY);
+		break;
+	}
+}
+
+static void finishWriteBlock(void)
+{
+	writeErased = blockErased(address);
+	erased[address >> 3] &= ~(1 << (address & 7));
+	if(pwrite(imageFd, block, SDCARD_BLOCK_SIZE, (off_t)address * SDCARD_BLOCK_SIZE) == SDCARD_BLOCK_SIZE){
+		sdcardStats.blocksWritten++;
+		diskmapWrite(address, block, 1);
+		address++;
+	}
+	if(preEraseCount)
+		preEraseCount--;
+	state = SD_STATE_WRITE_RESPONSE;
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	sdcardExchange
+ * Purpose:		Shifts one byte through the card
+ * Arguments:	mosi		Byte driven by the host on DI
+ *				selected	CS state (1: asserted)
+ * Returns:		Byte driven by the card on DO (0xFF while deselected)
+ * -------------------------------------------------------------------------- */
+
+uint8_t sdcardExchange(uint8_t mosi, uint8_t selected)
+{
+	uint8_t miso = 0xFF;
+	sdcardByteClass_t byteClass = SDCARD_BYTE_IDLE;
+
+	if(!selected){
+		if(state == SD_STATE_COMMAND)		// A partial frame is discarded
+			state = SD_STATE_READY;
+		if(state == SD_STATE_READ_WAIT)
+			readHeld = 1;
+		sdcardStats.bytes[SDCARD_BYTE_DESELECTED]++;
+		return 0xFF;
+	}
+	switch(state){
+	case SD_STATE_READY:
+		if((mosi & 0xC0) == 0x40){			// Start and transmission bits
+			frame[0] = mosi;
+			frameLength = 1;
+			state = SD_STATE_COMMAND;
+			byteClass = SDCARD_BYTE_COMMAND;
+		}
+		break;
+	case SD_STATE_COMMAND:
+		frame[frameLength++] = mosi;
+		byteClass = SDCARD_BYTE_COMMAND;
+		if(frameLength == 6)
+			executeCommand();
+		break;
+	case SD_STATE_RESPONSE:
+		miso = queue[queuePosition++];
+		byteClass = SDCARD_BYTE_RESPONSE;
+		if(queuePosition >= queueLength){
+			state = stateAfterResponse;
+			if(state == SD_STATE_READ_WAIT)
+				startRead();
+		}
+		break;
+	case SD_STATE_READ_WAIT:
+		byteClass = SDCARD_BYTE_READ_WAIT;
+		if((mosi & 0xC0) == 0x40){			// CMD12 while streaming
+			frame[0] = mosi;
+			frameLength = 1;
+			state = SD_STATE_COMMAND;
+			byteClass = SDCARD_BYTE_COMMAND;
+		}else if(!readHeld && (hostClockCycles() >= readyAt)){
+			loadReadPacket();
+			miso = queue[queuePosition++];
+			byteClass = SDCARD_BYTE_DATA;
+		}
+		break;
+	case SD_STATE_READ_DATA:
+		miso = queue[queuePosition++];
+		byteClass = SDCARD_BYTE_DATA;
+		if(queuePosition >= queueLength){
+			if(multiBlock && (address < imageBlocks))
+				startRead();
+			else
+				state = SD_STATE_READY;
+		}
+		break;
+	case SD_STATE_WRITE_TOKEN:
+		if(mosi == TOKEN_SINGLE || (multiBlock && mosi == TOKEN_MULTI_WRITE)){
+			blockPosition = 0;
+			state = SD_STATE_WRITE_DATA;
+			byteClass = SDCARD_BYTE_DATA;
+		}else if(multiBlock && mosi == TOKEN_STOP_TRAN){
+			multiBlock = 0;
+			byteClass = SDCARD_BYTE_DATA;
+			startBusy(sdcardConfig.stopBusyUs);
+		}
+		break;
+	case SD_STATE_WRITE_DATA:
+		block[blockPosition++] = mosi;
+		byteClass = SDCARD_BYTE_DATA;
+		if(blockPosition == SDCARD_BLOCK_SIZE + 2)	// Payload and CRC
+			finishWriteBlock();
+		break;
+	case SD_STATE_WRITE_RESPONSE:
+		miso = 0xE0 | DATA_ACCEPTED;
+		byteClass = SDCARD_BYTE_DATA;
+		if(writeErased){
+			sdcardStats.erasedWrites++;
+			startBusy(sdcardConfig.erasedBusyUs);
+		}else{
+			startBusy(multiBlock ? sdcardConfig.multiBusyUs : sdcardConfig.writeBusyUs);
+		}
+		break;
+	case SD_STATE_BUSY:
+		if(hostClockCycles() < readyAt){
+			miso = 0x00;
+			byteClass = SDCARD_BYTE_BUSY;
+		}else{
+			state = multiBlock ? SD_STATE_WRITE_TOKEN : SD_STATE_READY;
+		}
+		break;
+	}
+
+	if(sdcardConfig.maxSckKhz && (byteClass == SDCARD_BYTE_DATA) && (F_CPU / 1000 / hostSpiSckDivider() > sdcardConfig.maxSckKhz))
+		miso ^= 0x10;						// Wiring too slow for SCK: a bit is sampled late
+	sdcardStats.bytes[byteClass]++;
+	return miso;
+}
+
+uint64_t sdcardTotalBytes(const sdcardStats_t * stats)
+{
+	uint64_t total = 0;
+	uint8_t i;
+
+	for(i = 0; i < SDCARD_BYTE_CLASSES; i++)
+		total += stats->bytes[i];
+	return total;
+}
+
+void sdcardPrintStats(const sdcardStats_t * stats, FILE * stream)
+{
+	static const char * const names[SDCARD_BYTE_CLASSES] = {"deselected", "idle", "command", "response", "read wait", "data", "busy"};
+	uint8_t i;
+
+	fprintf(stream, "sdcard: %llu bytes clocked, %u blocks read, %u blocks written (%u pre-erased), %u blocks erased\n",
+		(unsigned long long)sdcardTotalBytes(stats), stats->blocksRead, stats->blocksWritten, stats->erasedWrites, stats->blocksErased);
+	for(i = 0; i < SDCARD_BYTE_CLASSES; i++)
+		fprintf(stream, "  %-11s %12llu\n", names[i], (unsigned long long)stats->bytes[i]);
+	for(i = 0; i < 64; i++){
+		if(stats->commands[i])
+			fprintf(stream, "  CMD%-2u  %10u\n", i, stats->commands[i]);
+		if(stats->appCommands[i])
+			fprintf(stream, "  ACMD%-2u %10u\n", i, stats->appCommands[i]);
+	}
+	fprintf(stream, "  spi bus time %.6f s\n", (double)hostSpiStats.cycles / F_CPU);
+}
+
+// -----------------------------------------------------------------------------
+// Initialization --------------------------------------------------------------
+
+__attribute__((constructor)) static void sdcardInsert(void)
+{
+	const char * path = getenv("SD_IMAGE");
+	uint32_t highCapacity = sdcardConfig.highCapacity;
+	struct stat st;
+
+	if(!path)
+		path = "sd.mmc";
+	imageFd = open(path, O_RDWR);
+	if(imageFd < 0){
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	if(fstat(imageFd, &st) == 0)
+		imageBlocks = (uint32_t)(st.st_size / SDCARD_BLOCK_SIZE);
+	erased = calloc(imageBlocks / 8 + 1, 1);
+
+	getEnvU32("SD_HIGH_CAPACITY", &highCapacity);
+	sdcardConfig.highCapacity = highCapacity ? 1 : 0;
+	getEnvU32("SD_INIT_US", &sdcardConfig.initTimeUs);
+	getEnvU32("SD_READ_LATENCY_US", &sdcardConfig.readLatencyUs);
+	getEnvU32("SD_WRITE_BUSY_US", &sdcardConfig.writeBusyUs);
+	getEnvU32("SD_MULTI_BUSY_US", &sdcardConfig.multiBusyUs);
+	getEnvU32("SD_STOP_BUSY_US", &sdcardConfig.stopBusyUs);
+	getEnvU32("SD_ERASE_BUSY_US", &sdcardConfig.eraseBusyUs);
+	getEnvU32("SD_ERASED_BUSY_US", &sdcardConfig.erasedBusyUs);
+	getEnvU32("SD_STALL_EVERY", &sdcardConfig.stallEvery);
+	getEnvU32("SD_STALL_US", &sdcardConfig.stallUs);
+	getEnvU32("SD_MAX_SCK_KHZ", &sdcardConfig.maxSckKhz);
+	getEnvU32("SD_AU_SIZE", &sdcardConfig.auSize);
+
+	hostSpiAttach(sdcardExchange);
+	atexit(sdcardClose);
+}
@@ -0,0 +1,71 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			sdcard.h
+ * Module:			SD card model (SPI mode)
+ * Purpose:			Byte-level model of an SD card wired to the SPI peripheral.
+ *					Implements CMD0/8/9/10/12/13/16/17/18/24/25/32/33/38/55/58
+ *					and ACMD13/23/41 over the sd.mmc image, with programmable latency
+ *					and busy times measured on the virtual clock, and counts
+ *					every byte clocked on the bus
+ * -------------------------------------------------------------------------- */
+
+#ifndef __SDCARD_H
+#define __SDCARD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct sdcardConfig_t{
+	uint8_t		highCapacity;		// 1: SDHC (block addressing), 0: SDSC
+	uint32_t	initTimeUs;			// Time from the first ACMD41 until the card leaves idle state
+	uint32_t	readLatencyUs;		// Time from a read command until the data token (Nac)
+	uint32_t	writeBusyUs;		// Programming time after a CMD24 block
+	uint32_t	multiBusyUs;		// Programming time after each CMD25 block
+	uint32_t	stopBusyUs;			// Programming time after the stop token
+	uint32_t	eraseBusyUs;		// Busy time after CMD38
+	uint32_t	erasedBusyUs;		// Programming time of a block erased by CMD38 (single or multiple)
+	uint32_t	stallEvery;			// Every stallEvery-th written block takes stallUs (0: never)
+	uint32_t	stallUs;
+	uint32_t	maxSckKhz;			// Fastest SCK the wiring carries; data bytes read faster are corrupted (0: no limit)
+	uint32_t	auSize;				// AU_SIZE field of the SD Status (16 KB << (n - 1), 0: not defined)
+} sdcardConfig_t;
+
+typedef enum sdcardByteClass_t{
+	SDCARD_BYTE_DESELECTED = 0,		// Clocked with CS high
+	SDCARD_BYTE_IDLE,				// CS low, nothing in progress (dummy clocks, ready polls)
+	SDCARD_BYTE_COMMAND,			// Command frame
+	SDCARD_BYTE_RESPONSE,			// Ncr polling and response bytes
+	SDCARD_BYTE_READ_WAIT,			// Nac polling before a data token
+	SDCARD_BYTE_DATA,				// Data tokens, payload, CRC and data response
+	SDCARD_BYTE_BUSY,				// Busy polling while the card programs
+	SDCARD_BYTE_CLASSES
+} sdcardByteClass_t;
+
+typedef struct sdcardStats_t{
+	uint64_t	bytes[SDCARD_BYTE_CLASSES];
+	uint32_t	commands[64];		// CMDn count
+	uint32_t	appCommands[64];	// ACMDn count
+	uint32_t	blocksRead;
+	uint32_t	blocksWritten;
+	uint32_t	erasedWrites;		// Blocks written into an erased area
+	uint32_t	blocksErased;
+	uint32_t	illegalCommands;
+} sdcardStats_t;
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+extern sdcardConfig_t sdcardConfig;
+extern sdcardStats_t sdcardStats;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+uint8_t		sdcardExchange(uint8_t mosi, uint8_t selected);
+uint64_t	sdcardTotalBytes(const sdcardStats_t * stats);
+void		sdcardPrintStats(const sdcardStats_t * stats, FILE * stream);
+
+#endif
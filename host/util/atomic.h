@@ -0,0 +1,47 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			util/atomic.h
+ * Module:			Atomic block shim for the host (PC) build
+ * Purpose:			Same construction as avr-libc: save SREG, clear the I bit and
+ *					restore (or force) it when the block is left
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOST_UTIL_ATOMIC_H
+#define __HOST_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+static __inline__ uint8_t hostAtomicCli(void)
+{
+	cli();
+	return 1;
+}
+
+static __inline__ void hostAtomicRestore(const uint8_t * sreg)
+{
+	SREG = *sreg;
+	if(*sreg & (1 << SREG_I))
+		sei();
+}
+
+static __inline__ void hostAtomicForceOn(const uint8_t * sreg)
+{
+	(void)sreg;
+	sei();
+}
+
+static __inline__ void hostAtomicForceOff(const uint8_t * sreg)
+{
+	(void)sreg;
+	cli();
+}
+
+#define ATOMIC_BLOCK(type)		for(type, hostAtomicToDo = hostAtomicCli(); hostAtomicToDo; hostAtomicToDo = 0)
+#define NONATOMIC_BLOCK(type)	for(type, hostAtomicToDo = (sei(), 1); hostAtomicToDo; hostAtomicToDo = 0)
+
+#define ATOMIC_RESTORESTATE		uint8_t hostSregSave __attribute__((__cleanup__(hostAtomicRestore))) = SREG
+#define ATOMIC_FORCEON			uint8_t hostSregSave __attribute__((__cleanup__(hostAtomicForceOn))) = 0
+#define NONATOMIC_RESTORESTATE	uint8_t hostSregSave __attribute__((__cleanup__(hostAtomicRestore))) = SREG
+#define NONATOMIC_FORCEOFF		uint8_t hostSregSave __attribute__((__cleanup__(hostAtomicForceOff))) = 0
+
+#endif
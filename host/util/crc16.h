@@ -0,0 +1,25 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			util/crc16.h
+ * Module:			CRC shim for the host (PC) build
+ * Purpose:			C versions of the avr-libc CRC update functions used by the
+ *					firmware
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOST_UTIL_CRC16_H
+#define __HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+/* CRC-16/XMODEM (polynomial 0x1021, initial value 0): the SD data block CRC */
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	uint8_t i;
+
+	crc ^= (uint16_t)data << 8;
+	for(i = 0; i < 8; i++)
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	return crc;
+}
+
+#endif
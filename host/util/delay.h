@@ -0,0 +1,16 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao - host build
+ * File:			util/delay.h
+ * Module:			Busy-wait delay shim for the host (PC) build
+ * Purpose:			Delays advance the virtual clock instead of burning host time
+ * -------------------------------------------------------------------------- */
+
+#ifndef __HOST_UTIL_DELAY_H
+#define __HOST_UTIL_DELAY_H
+
+#include "hostclock.h"
+
+#define _delay_us(us)	hostClockDelayUs(us)
+#define _delay_ms(ms)	hostClockDelayUs((ms) * 1000.0)
+
+#endif
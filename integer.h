@@ -10,6 +10,27 @@
 #include <windows.h>
 #include <tchar.h>
 
+#elif defined(HOST_BUILD)	/* Host (PC) build of the AVR firmware */
+
+#include <stdint.h>
+
+/* Same widths as avr-gcc, so the firmware behaves as it does on the device */
+typedef int16_t			INT;
+typedef uint16_t		UINT;
+
+typedef char			CHAR;
+typedef unsigned char	UCHAR;
+typedef unsigned char	BYTE;
+
+typedef int16_t			SHORT;
+typedef uint16_t		USHORT;
+typedef uint16_t		WORD;
+typedef uint16_t		WCHAR;
+
+typedef int32_t			LONG;
+typedef uint32_t		ULONG;
+typedef uint32_t		DWORD;
+
 #else			/* Embedded platform */
 
 /* These types must be 16-bit, 32-bit or larger integer */
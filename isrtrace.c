@@ -0,0 +1,142 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			isrtrace.c
+ * Module:			Interrupt service routine trace
+ * Purpose:			Timestamps the entry and exit of ISR(TIMER0_OVF_vect),
+ *					ISR(ADC_vect) and ISR(TWI_vect) with Timer1, keeps the last
+ *					events in a ring buffer and reports the duration and the
+ *					latency of each vector
+ * -------------------------------------------------------------------------- */
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "isrtrace.h"
+#if __ISRTRACE_H != 10
+	#error Error 101 - Version mismatch on header and source code files (isrTrace).
+#endif
+
+#ifdef ISR_TRACE
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "globalDefines.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define ISR_TRACE_CLOCK_SELECT		(1 << CS11)
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+volatile uint8_t isrTraceEnabled = 0;
+volatile uint8_t isrTraceHead = 0;
+isrTraceEvent_t isrTraceEvents[ISR_TRACE_DEPTH];
+isrTraceStats_t isrTraceStats[ISR_TRACE_VECTORS];
+
+// -----------------------------------------------------------------------------
+// Private function definitions ------------------------------------------------
+
+static PGM_P isrTraceName(uint8_t vector)
+{
+	switch(vector){
+	case ISR_TRACE_TIMER0_OVF:	return PSTR("TIMER0_OVF");
+	case ISR_TRACE_ADC:			return PSTR("ADC");
+	case ISR_TRACE_TWI:			return PSTR("TWI");
+	default:					return PSTR("?");
+	}
+}
+
+/* Tenths of microsecond */
+static uint32_t isrTraceTicksToTenths(uint32_t ticks)
+{
+	return ticks * ISR_TRACE_PRESCALER * 10UL / (F_CPU / 1000000UL);
+}
+
+static void isrTracePrintTime(uint32_t ticks)
+{
+	uint32_t tenths = isrTraceTicksToTenths(ticks);
+
+	printf_P(PSTR(" %6lu.%lu"), (unsigned long)(tenths / 10), (unsigned long)(tenths % 10));
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	isrTraceStart
+ * Purpose:		Starts Timer1 as a free-running time base and enables tracing
+ * Arguments:	none
+ * Returns:		none
+ * Notes:		Call after bootProfileReport(), which stops Timer1
+ * -------------------------------------------------------------------------- */
+
+void isrTraceStart(void)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1 = 0;
+	TCCR1B = ISR_TRACE_CLOCK_SELECT;
+	memset(isrTraceStats, 0, sizeof(isrTraceStats));
+	memset(isrTraceEvents, 0xFF, sizeof(isrTraceEvents));
+	isrTraceHead = 0;
+	isrTraceEnabled = 1;
+	SREG = sreg;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	isrTraceReport
+ * Purpose:		Prints the statistics of each vector since the last report and
+ *				the events in the ring buffer, oldest first, then restarts the
+ *				statistics
+ * Arguments:	none
+ * Returns:		none
+ * Notes:		Times in microseconds. Uses printf, so the USART must already
+ *				be bound to stdout
+ * -------------------------------------------------------------------------- */
+
+void isrTraceReport(void)
+{
+	isrTraceStats_t stats[ISR_TRACE_VECTORS];
+	isrTraceEvent_t events[ISR_TRACE_DEPTH];
+	char name[12];
+	uint8_t head;
+	uint8_t sreg = SREG;
+	uint8_t i;
+
+	cli();
+	memcpy(stats, isrTraceStats, sizeof(stats));
+	memcpy(events, isrTraceEvents, sizeof(events));
+	head = isrTraceHead;
+	for(i = 0; i < ISR_TRACE_VECTORS; i++)
+		isrTraceStats[i].count = 0;
+	SREG = sreg;
+
+	printf_P(PSTR("ISR trace (us): vector count duration min/avg/max latency avg/max\n\r"));
+	for(i = 0; i < ISR_TRACE_VECTORS; i++){
+		if(!stats[i].count)
+			continue;
+		strcpy_P(name, isrTraceName(i));
+		printf_P(PSTR("%-10s %5u"), name, stats[i].count);
+		isrTracePrintTime(stats[i].durationMin);
+		isrTracePrintTime(stats[i].durationSum / stats[i].count);
+		isrTracePrintTime(stats[i].durationMax);
+		if(i != ISR_TRACE_TWI){
+			isrTracePrintTime(stats[i].phaseSum / stats[i].count - stats[i].phaseMin);
+			isrTracePrintTime(stats[i].phaseMax - stats[i].phaseMin);
+		}
+		printf_P(PSTR("\n\r"));
+	}
+	for(i = 0; i < ISR_TRACE_DEPTH; i++, head = (head + 1) & (ISR_TRACE_DEPTH - 1)){
+		if(events[head].vector >= ISR_TRACE_VECTORS)
+			continue;
+		strcpy_P(name, isrTraceName(events[head].vector));
+		printf_P(PSTR("  %-10s %5u +%u\n\r"), name, events[head].entry, events[head].exit - events[head].entry);
+	}
+}
+
+#endif
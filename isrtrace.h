@@ -0,0 +1,141 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			isrtrace.h
+ * Module:			Interrupt service routine trace
+ * Purpose:			Timestamps the entry and exit of ISR(TIMER0_OVF_vect),
+ *					ISR(ADC_vect) and ISR(TWI_vect) with Timer1, keeps the last
+ *					events in a ring buffer and reports the duration and the
+ *					latency of each vector
+ * Notes:			Compiled in only when ISR_TRACE is defined; otherwise the
+ *					macros below expand to nothing. Timer1 runs free at F_CPU/8
+ *					(0.5 us per tick at 16 MHz) once isrTraceStart() is called.
+ *					The duration is measured from the first to the last
+ *					statement of the ISR, so the register save and restore of
+ *					the prologue and epilogue are not included.
+ *					Timer0 overflows every 256 * 1024 clock cycles and starts
+ *					the ADC conversion (auto trigger), so both vectors repeat
+ *					with a period that divides the Timer1 period: the latency
+ *					is the phase of the entry inside that period above the
+ *					smallest phase seen, i.e. the delay caused by masked
+ *					sections and other ISRs. TWI interrupts are not periodic
+ *					and the moment TWINT is set cannot be timestamped, so only
+ *					their duration is reported
+ * -------------------------------------------------------------------------- */
+
+#ifndef __ISRTRACE_H
+#define __ISRTRACE_H 10
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#ifndef ISR_TRACE_DEPTH
+	#define ISR_TRACE_DEPTH				16		// Power of two
+#endif
+
+#ifndef ISR_TRACE_PERIOD
+	#define ISR_TRACE_PERIOD			6		// Records between reports (1 minute)
+#endif
+
+#define ISR_TRACE_PRESCALER				8
+#define ISR_TRACE_TIMER0_TICKS			(256UL * 1024UL / ISR_TRACE_PRESCALER)
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef enum isrTraceVector_t{
+	ISR_TRACE_TIMER0_OVF = 0,
+	ISR_TRACE_ADC,
+	ISR_TRACE_TWI,
+	ISR_TRACE_VECTORS
+} isrTraceVector_t;
+
+typedef struct isrTraceEvent_t{
+	uint8_t		vector;
+	uint16_t	entry;					// Timer1 ticks
+	uint16_t	exit;
+} isrTraceEvent_t;
+
+typedef struct isrTraceStats_t{
+	uint16_t	count;
+	uint16_t	durationMin;			// Timer1 ticks
+	uint16_t	durationMax;
+	uint32_t	durationSum;
+	int16_t		phaseMin;				// Entry phase, relative to the first entry
+	int16_t		phaseMax;
+	int32_t		phaseSum;
+	uint16_t	phaseOrigin;
+} isrTraceStats_t;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+#ifdef ISR_TRACE
+	extern volatile uint8_t isrTraceEnabled;
+	extern volatile uint8_t isrTraceHead;
+	extern isrTraceEvent_t isrTraceEvents[ISR_TRACE_DEPTH];
+	extern isrTraceStats_t isrTraceStats[ISR_TRACE_VECTORS];
+
+	void	isrTraceStart(void);
+	void	isrTraceReport(void);
+
+	/* Inlined in the ISRs so that tracing does not turn them into callers,
+	 * which would make the compiler save every call-clobbered register */
+	static inline __attribute__((always_inline)) void isrTraceRecord(isrTraceVector_t vector, uint16_t entry, uint16_t exit)
+	{
+		isrTraceStats_t * stats = &isrTraceStats[vector];
+		isrTraceEvent_t * event;
+		uint16_t duration = exit - entry;
+		int16_t phase;
+
+		if(!isrTraceEnabled)
+			return;
+		event = &isrTraceEvents[isrTraceHead];
+		isrTraceHead = (isrTraceHead + 1) & (ISR_TRACE_DEPTH - 1);
+		event->vector = vector;
+		event->entry = entry;
+		event->exit = exit;
+
+		if(!stats->count){
+			stats->durationMin = 0xFFFF;
+			stats->durationMax = 0;
+			stats->durationSum = 0;
+			stats->phaseMin = 0x7FFF;
+			stats->phaseMax = -0x8000;
+			stats->phaseSum = 0;
+			if(vector != ISR_TRACE_TWI)
+				stats->phaseOrigin = entry;
+		}
+		if(stats->count != 0xFFFF)
+			stats->count++;
+		if(duration < stats->durationMin)
+			stats->durationMin = duration;
+		if(duration > stats->durationMax)
+			stats->durationMax = duration;
+		stats->durationSum += duration;
+		if(vector != ISR_TRACE_TWI){
+			phase = (entry - stats->phaseOrigin) & (ISR_TRACE_TIMER0_TICKS - 1);
+			if(phase >= (int16_t)(ISR_TRACE_TIMER0_TICKS / 2))
+				phase -= ISR_TRACE_TIMER0_TICKS;
+			if(phase < stats->phaseMin)
+				stats->phaseMin = phase;
+			if(phase > stats->phaseMax)
+				stats->phaseMax = phase;
+			stats->phaseSum += phase;
+		}
+	}
+
+	#define ISR_TRACE_ENTER()			uint16_t isrTraceEntry = TCNT1
+	#define ISR_TRACE_EXIT(vector)		isrTraceRecord((vector), isrTraceEntry, TCNT1)
+#else
+	#define isrTraceStart()
+	#define isrTraceReport()
+	#define ISR_TRACE_ENTER()
+	#define ISR_TRACE_EXIT(vector)
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			logcommit.c
+ * Module:			Log commit policy
+ * Purpose:			Decides when the log is committed with f_sync(): after
+ *					LOG_COMMIT_RECORDS records, when the oldest record not yet
+ *					committed is LOG_COMMIT_SECONDS old, when a sector of the
+ *					file fills up, and at once when the power-fail input falls
+ * -------------------------------------------------------------------------- */
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "logcommit.h"
+#if __LOGCOMMIT_H != 10
+	#error Error 101 - Version mismatch on header and source code files (logCommit).
+#endif
+
+#include "globalDefines.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define LOG_COMMIT_DAY				86400UL
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+volatile uint8_t logCommitPowerFail = 0;
+
+static uint16_t logCommitPending = 0;		// Records written since the last commit
+static uint32_t logCommitOldest = 0;		// Second of the day of the first of them
+static DWORD logCommitSector = 0;			// File sector holding the end of the file at the last commit
+static uint8_t logCommitInput = 0;			// PD2 configured by logCommitInit()
+
+// -----------------------------------------------------------------------------
+// Private function definitions ------------------------------------------------
+
+static FRESULT logCommitSync(FIL * file)
+{
+	FRESULT result = f_sync(file);
+
+	if(result == FR_OK){
+		logCommitPending = 0;
+		logCommitSector = f_tell(file) / 512;
+	}
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// Interrupt handlers ----------------------------------------------------------
+
+ISR(INT0_vect)
+{
+	logCommitPowerFail = 1;
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	logCommitInit
+ * Purpose:		Starts the policy on an open log and enables the power-fail
+ *				interrupt (INT0, falling edge)
+ * Arguments:	file		Log file, already positioned at its end
+ * Returns:		none
+ * -------------------------------------------------------------------------- */
+
+void logCommitInit(FIL * file)
+{
+	logCommitPending = 0;
+	logCommitSector = f_tell(file) / 512;
+
+	clrBit(DDRD, PD2);						// Input with pull-up
+	setBit(PORTD, PD2);
+	EICRA = (EICRA & ~((1 << ISC01) | (1 << ISC00))) | (1 << ISC01);
+	EIFR = (1 << INTF0);					// Discard an edge seen while configuring
+	setBit(EIMSK, INT0);
+	logCommitInput = 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	logCommitWait
+ * Purpose:		Waits between records, committing at once if the power-fail
+ *				input falls meanwhile
+ * Arguments:	file		Log file
+ *				ms			Time to wait
+ * Returns:		none
+ * Notes:		Replaces _delay_ms(ms) in the main loop; the time spent in the
+ *				commit is not deducted
+ * -------------------------------------------------------------------------- */
+
+void logCommitWait(FIL * file, uint16_t ms)
+{
+	while(ms){
+		if(logCommitPowerFail){
+			logCommitPowerFail = 0;
+			logCommitFlush(file);
+		}
+		_delay_ms(LOG_COMMIT_SLICE_MS);
+		ms = (ms > LOG_COMMIT_SLICE_MS) ? (ms - LOG_COMMIT_SLICE_MS) : 0;
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	logCommitRecord
+ * Purpose:		Accounts a record written to the log and commits the log when
+ *				the policy says so
+ * Arguments:	file		Log file
+ *				time		Second of the day of the record (RTC)
+ * Returns:		Result of f_sync(), FR_OK when no commit was due
+ * Notes:		The power-fail input is read only after logCommitInit(): before
+ *				it PD2 has no pull-up and floats
+ * -------------------------------------------------------------------------- */
+
+FRESULT logCommitRecord(FIL * file, uint32_t time)
+{
+	if(!logCommitPending++)
+		logCommitOldest = time;
+
+	if(logCommitPending >= LOG_COMMIT_RECORDS)
+		return logCommitSync(file);
+	if((time + LOG_COMMIT_DAY - logCommitOldest) % LOG_COMMIT_DAY >= LOG_COMMIT_SECONDS)
+		return logCommitSync(file);
+#if LOG_COMMIT_SECTOR
+	if(f_tell(file) / 512 != logCommitSector)	// The sector of the last commit is full
+		return logCommitSync(file);
+#endif
+	if(logCommitInput && isBitClr(PIND, PD2))	// Power still failing: write through
+		return logCommitSync(file);
+	return FR_OK;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	logCommitFlush
+ * Purpose:		Commits the records written since the last commit, if any
+ * Arguments:	file		Log file
+ * Returns:		Result of f_sync(), FR_OK when nothing was pending
+ * Notes:		Call before a planned shutdown or reset
+ * -------------------------------------------------------------------------- */
+
+FRESULT logCommitFlush(FIL * file)
+{
+	if(!logCommitPending)
+		return FR_OK;
+	return logCommitSync(file);
+}
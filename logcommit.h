@@ -0,0 +1,56 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			logcommit.h
+ * Module:			Log commit policy
+ * Purpose:			Decides when the log is committed with f_sync(): after
+ *					LOG_COMMIT_RECORDS records, when the oldest record not yet
+ *					committed is LOG_COMMIT_SECONDS old, when a sector of the
+ *					file fills up, and at once when the power-fail input falls
+ * Notes:			Records written after the last commit are lost on a reset or
+ *					power cut, so the loss window is the first of the limits
+ *					above to be reached. LOG_COMMIT_RECORDS = 1 commits every
+ *					record, as before. The power-fail input is INT0 (PD2), active
+ *					low, driven by a supply supervisor or a shutdown switch; the
+ *					internal pull-up keeps an unconnected pin high. The ISR only
+ *					sets a flag: logCommitWait() replaces the delay of the main
+ *					loop, watches the flag and commits as soon as it is set.
+ *					While the input stays low every record is committed
+ * -------------------------------------------------------------------------- */
+
+#ifndef __LOGCOMMIT_H
+#define __LOGCOMMIT_H 10
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include <stdint.h>
+#include "ff.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#ifndef LOG_COMMIT_RECORDS
+	#define LOG_COMMIT_RECORDS		30		// Records between commits (5 minutes)
+#endif
+
+#ifndef LOG_COMMIT_SECONDS
+	#define LOG_COMMIT_SECONDS		300		// Age of the oldest record not committed
+#endif
+
+#ifndef LOG_COMMIT_SECTOR
+	#define LOG_COMMIT_SECTOR		1		// 1: also commit when a sector fills up
+#endif
+
+#define LOG_COMMIT_SLICE_MS			10		// Power-fail polling period of logCommitWait()
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+extern volatile uint8_t logCommitPowerFail;
+
+void	logCommitInit(FIL * file);
+void	logCommitWait(FIL * file, uint16_t ms);
+FRESULT	logCommitRecord(FIL * file, uint32_t time);
+FRESULT	logCommitFlush(FIL * file);
+
+#endif
@@ -15,6 +15,17 @@
 #include "ff.h"
 #include "sensor.h"
 #include "ds1307.h"
+#include "bootprofile.h"
+#include "ramusage.h"
+#include "isrtrace.h"
+#include "mmcstats.h"
+#include "logcommit.h"
+#ifdef SPI_BENCH
+#include "spi.h"
+#endif
+#ifdef SD_USART_SPI
+#include "softuart.h"
+#endif
 #include <string.h>
 
 
@@ -29,6 +40,15 @@
 
 
 #define LED_PIN	PB0
+
+// Crescimento do log apagado antecipadamente a cada dia (8640 registros de
+// ate 22 bytes): as escritas em blocos ja apagados terminam mais rapido
+#define PRE_ERASE_BYTES		196608UL
+// Clusters contiguos reservados a frente do fim do log a cada dia: o f_write
+// passa de um cluster ao seguinte sem ler nem escrever a FAT
+#define PRE_ALLOC_BYTES		196608UL
+// Itens da tabela de clusters do log (fast seek): 2 + 2 por fragmento
+#define LINK_MAP_ITEMS		16
 // AD0-a0(sensor radiacao)
 
 //cartao SD
@@ -46,8 +66,11 @@
 #define DRV_MMC
 
 int main(){
+	bootProfileStart();
+
 	/* Inicializa o converor AD (sensor radiacao)*/
 	adcEtimer_init();
+	BOOT_MARK(BOOT_EVENT_ADC_INIT, 0);
 
 	//cartao
 
@@ -56,32 +79,55 @@ int main(){
 	FATFS card;
 	FIL file;
 	char string[64];
-
-	uint16_t bytesWritten, result=0, n=0;
+#if _USE_FASTSEEK
+	DWORD linkMap[LINK_MAP_ITEMS];
+#endif
+
+	uint16_t bytesWritten, result=0;
+#ifdef RAM_USAGE
+	uint16_t records = 0;
+#endif
+#ifdef ISR_TRACE
+	uint8_t traceRecords = 0;
+#endif
+#ifdef MMC_STATS
+	uint16_t statsRecords = 0;
+#endif
+#if _USE_ERASE || _USE_PREALLOC
+	uint8_t lastHour = 24;
+#endif
 
 	//sensor efeito hall
 	uint16_t AD_hall=0;
 
-	//tensao
-	uint32_t tensao_res=0, potencia_res=0, corrente_res=0, pot1=0, pot2=0;
 	uint16_t AD_radiacao=0;
 	memset(string, 0, sizeof(string));
 
 	// TWI Init
 	twiMasterInit(10000);
+	BOOT_MARK(BOOT_EVENT_TWI_INIT, 0);
 
 	// UART configuration
+#ifdef SD_USART_SPI
+	// USART0 drives the SD card (usartspi.c): console on the software UART
+	softUartInit();
+	softUartStdio();
+#else
 	usartConfig(USART_MODE_ASYNCHRONOUS, USART_BAUD_9600, USART_DATA_BITS_8, USART_PARITY_NONE, USART_STOP_BIT_SINGLE);
 	usartEnableReceiver();
 	usartEnableTransmitter();
 	usartStdio();
+#endif
+	BOOT_MARK(BOOT_EVENT_USART_INIT, 0);
 	printf("SD Card Example\n \r");
+	BOOT_MARK(BOOT_EVENT_BANNER, 0);
 
 	// Enable Global Interrupts
 	sei();
 
 	// RTC Configuration
 	ds1307SetControl(DS1307_COUNTING_RESUME, DS1307_CLOCK_1HZ, DS1307_FORMAT_24_HOURS);
+	BOOT_MARK(BOOT_EVENT_RTC_CONTROL, 0);
 
 	//comentar depois de gravar
 	//ds1307SetDate(ANO, MES, DIA, DIA_SEMANA);
@@ -89,6 +135,7 @@ int main(){
 	// Mounting SD card
 
 	res = f_mount(0, &card);
+	BOOT_MARK(BOOT_EVENT_MOUNT, 0);
 	if(res != FR_OK){
 		printf("->SD card not mounted => error = %d\n \r", res);
 	}else{
@@ -96,25 +143,48 @@ int main(){
 	}
 
 	ds1307SetControl(DS1307_COUNTING_NO_CHANGE,DS1307_CLOCK_NO_CHANGE, DS1307_FORMAT_24_HOURS );
+	BOOT_MARK(BOOT_EVENT_RTC_FORMAT, 0);
 
 
 	//printf("antes res ");
 
-	res = f_open(&file, "Radiacao.csv", FA_WRITE | FA_CREATE_ALWAYS);
+	// Continua o log anterior: a tabela de clusters e montada uma vez e o
+	// f_write a mantem enquanto o arquivo cresce, entao ir ao fim do arquivo
+	// nao percorre a FAT
+	res = f_open(&file, "Radiacao.csv", FA_WRITE | FA_OPEN_ALWAYS);
+	BOOT_MARK(BOOT_EVENT_OPEN, 0);
 	//printf("depois res");
+#if _USE_FASTSEEK
+	if(res == FR_OK){
+		linkMap[0] = LINK_MAP_ITEMS;
+		file.cltbl = linkMap;
+		if(f_lseek(&file, CREATE_LINKMAP) != FR_OK)
+			file.cltbl = 0;			// Cadeia muito fragmentada: seek normal
+	}
+#endif
+	if(res == FR_OK)
+		res = f_lseek(&file, f_size(&file));
 
 	if(res != FR_OK){
-		printf("->File not created => error = %d \n \r", res);
+		printf("->File not opened => error = %d \n \r", res);
 	}
 	else{
-		printf("->File created successfully \n \r ");
+		printf("->File opened at %lu bytes \n \r ", (unsigned long)f_size(&file));
 
 	}
+	bootProfileReport();
+	ramUsagePrint();
+#ifdef SPI_BENCH
+	SPI_Benchmark();
+#endif
+	isrTraceStart();
+	if(res == FR_OK)
+		logCommitInit(&file);
 
 
 	while(1){
 		//sensor efeito hall
-		_delay_ms(10000); // a cada 30 segundos
+		logCommitWait(&file, 10000); // a cada 10 segundos; grava o log se a energia cair
 		ds1307GetTime(&(dados_t.tempo_t.hora),&(dados_t.tempo_t.minuto) ,&(dados_t.tempo_t.segundo),&(dados_t.tempo_t.am_pm)); // define  funfa??
 
 		AD_hall = (dados_t.dado_tensao>>3);
@@ -122,21 +192,61 @@ int main(){
 		AD_radiacao = (dados_t.dado_radiacao>>3);
 		printf("ad_rad: %d\n", AD_radiacao);
 
-		n = snprintf(string, 64, "%d; %d; %d:%d:%d\n", AD_hall, AD_radiacao, dados_t.tempo_t.hora, dados_t.tempo_t.minuto, dados_t.tempo_t.segundo);
+		snprintf(string, 64, "%d; %d; %d:%d:%d\n", AD_hall, AD_radiacao, dados_t.tempo_t.hora, dados_t.tempo_t.minuto, dados_t.tempo_t.segundo);
 		printf("SNPRINTF: %s\n", string);
 		result = f_write(&file, string, strlen(string), &bytesWritten);
-		//3.19 resistor que esta medindo em cima 10+10 em serie
 
-		tensao_res =( AD_hall*5)/1024;
-		corrente_res = (tensao_res*10)/3.19; // multiplicada por 10
-		potencia_res = (10*corrente_res*corrente_res)+(10*corrente_res*corrente_res)+(3.19*corrente_res*corrente_res);
-		pot1 = potencia_res/10;
-		pot2 = potencia_res%10;
+		if(result!=0){
+			printf("fr_ok = %d",result);
+		}
+		// Grava o log em grupo (logcommit.h) em vez de um f_sync por registro
+		result = logCommitRecord(&file, dados_t.tempo_t.hora * 3600UL + dados_t.tempo_t.minuto * 60 + dados_t.tempo_t.segundo);
 
 		if(result!=0){
 			printf("fr_ok = %d",result);
 		}
-		f_sync(&file);
+
+#if _USE_ERASE || _USE_PREALLOC
+		// Primeiro registro e inicio de cada dia: reserva os clusters do dia
+		// seguinte e apaga os clusters em que o arquivo vai crescer. Sem o
+		// arquivo aberto card.csize e 0
+		if((res == FR_OK) && (dados_t.tempo_t.hora < lastHour)){
+#if _USE_PREALLOC
+			result = f_prealloc(&file, f_size(&file) + PRE_ALLOC_BYTES);
+			if(result!=0){
+				printf("fr_ok = %d",result);
+			}
+#endif
+#if _USE_ERASE
+			result = f_preerase(&file, (PRE_ERASE_BYTES / 512 + card.csize - 1) / card.csize);
+			if(result!=0){
+				printf("fr_ok = %d",result);
+			}
+#endif
+		}
+		lastHour = dados_t.tempo_t.hora;
+#endif
+
+#ifdef RAM_USAGE
+		if(++records == RAM_USAGE_PERIOD){
+			records = 0;
+			ramUsagePrint();
+			ramUsageDump(RAM_USAGE_FILE);
+		}
+#endif
+#ifdef ISR_TRACE
+		if(++traceRecords == ISR_TRACE_PERIOD){
+			traceRecords = 0;
+			isrTraceReport();
+		}
+#endif
+#ifdef MMC_STATS
+		if(++statsRecords == MMC_STATS_PERIOD){
+			statsRecords = 0;
+			mmcStatsPrint();
+			mmcStatsDump(MMC_STATS_FILE);
+		}
+#endif
 	}
 }
 
@@ -13,9 +13,14 @@
 
 #include "globalDefines.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
+#include <util/crc16.h>
+#include <avr/pgmspace.h>
 #include "diskio.h"
 #include "spi.h"
+#include "bootprofile.h"
+#include "mmcstats.h"
 
 
 /*-------------------------------------------------------------------------*/
@@ -25,11 +30,23 @@
 #define	INIT_PORT()	SPI_Init()			/* Initialize MMC control port (CS/CLK/DI:output, DO:input) */
 #define DLY_US(n)	_delay_us(n)		/* Delay n microseconds */
 
+#define	TMR_INIT()	{ TCCR2A = 0; TCCR2B = (1<<CS22); TIMSK2 = 0; }	/* Timer2 runs free at F_CPU/64 for the timeouts */
+#define	TMR_READ()	TCNT2
+#define	TMR_TICK_ON()	{ TIFR2 = (1<<TOV2); TIMSK2 |= (1<<TOIE2); }	/* Count the wraps (non-blocking write) */
+#define	TMR_TICK_OFF()	TIMSK2 &= ~(1<<TOIE2)
+#define	TMR_WRAPPED()	(TIFR2 & (1<<TOV2))
+#define	TMR_MS		(F_CPU / 64 / 1000)	/* Timer2 counts per millisecond */
+
 #define	CS_H()		PORTB |= (1<<PB2)	/* Set MMC CS "high" */
 #define CS_L()		PORTB &= ~(1<<PB2)	/* Set MMC CS "low" */
 
-#define SPI_CLK_FAST  SPCR = ((SPCR/* | (1<<SPI2X)*/)  & ~((1<<SPR1) | (1<<SPR0))) /*F_CPU/2*/
-#define SPI_CLK_LOW  SPCR |= (/*(1<<SPI2X) | */(1<<SPR1) | (1<<SPR0))			   /*F_CPU/64*/
+#define SPI_CLK_SET(d)	SPI_SetClockDivider(d)	/* F_CPU/d (d = 2, 4, ..., 128) */
+#define SPI_CLK_LOW		SPI_SetClockSlow()	/* F_CPU/128 */
+
+#ifndef SCK_MAX_KHZ
+#define SCK_MAX_KHZ	(F_CPU / 2000)	/* Fastest SCK the wiring carries (kHz) */
+#endif
+#define	CLK_TESTS	2				/* Sector reads in the self-test of each clock */
 
 #define	INS			(1)			/* Card is inserted (yes:true, no:false, default:true) */
 #define	WP			(0)			/* Card is write protected (yes:true, no:false, default:false) */
@@ -58,6 +75,9 @@
 #define	ACMD23	(0x80+23)	/* SET_WR_BLK_ERASE_COUNT (SDC) */
 #define CMD24	(24)		/* WRITE_BLOCK */
 #define CMD25	(25)		/* WRITE_MULTIPLE_BLOCK */
+#define CMD32	(32)		/* ERASE_ER_BLK_START */
+#define CMD33	(33)		/* ERASE_ER_BLK_END */
+#define CMD38	(38)		/* ERASE */
 #define CMD41	(41)		/* SEND_OP_COND (ACMD) */
 #define CMD55	(55)		/* APP_CMD */
 #define CMD58	(58)		/* READ_OCR */
@@ -69,6 +89,16 @@
 #define CT_SDC		(CT_SD1|CT_SD2)	/* SD */
 #define CT_BLOCK	0x08		/* Block addressing */
 
+/* Non-blocking write states (WrState) */
+#define WS_IDLE		0
+#define WS_READY	1			/* Waiting for the card to be ready */
+#define WS_PROGRAM	2			/* Card programming the sector */
+#define WS_FAILED	3			/* Error not reported by mmc_write_poll() yet */
+
+#define READY_MS	500			/* wait_ready() timeout before a command or a data block */
+#define TOKEN_MS	100			/* Timeout of the data token of a read */
+#define ERASE_MS	30000		/* wait_ready() timeout after CMD38 */
+
 
 static
 DSTATUS Stat = STA_NOINIT;	/* Disk status */
@@ -76,6 +106,36 @@ DSTATUS Stat = STA_NOINIT;	/* Disk status */
 static
 BYTE CardType;			/* b0:MMC, b1:SDv1, b2:SDv2, b3:Block addressing */
 
+static
+BYTE WrOpen;			/* A write session (CMD25) is open */
+
+static
+DWORD WrSector;			/* Next sector (LBA) of the write session */
+
+static
+DWORD WrLeft;			/* Sectors pre-erased by ACMD23 and not written yet */
+
+static
+BYTE WrState;			/* Non-blocking write state (WS_*) */
+
+static
+const BYTE *WrBuff;		/* Data of the non-blocking write (caller's buffer) */
+
+static
+DWORD WrTarget;			/* Sector (LBA) of the non-blocking write */
+
+static
+BYTE TmrLast;			/* Timer2 count at the last tmr_elapsed() */
+
+static
+DWORD TmrCount;			/* Timer2 counts since tmr_start() */
+
+static volatile
+DWORD TmrWraps;			/* Timer2 wraps counted by TIMER2_OVF_vect */
+
+static
+DWORD WrStart;			/* tmr_now() at the start of the non-blocking wait */
+
 
 
 /*-----------------------------------------------------------------------*/
@@ -88,13 +148,7 @@ void xmit_mmc (
 	UINT bc				/* Number of bytes to send */
 )
 {
-	BYTE d;
-
-
-	do {
-		d = *buff++;	/* Get a byte to be sent */
-		SPI_SendByte((char) d);
-	} while (--bc);
+	SPI_SendBlock(buff, bc);	/* Pipelined: next byte loaded while the current one shifts */
 }
 
 
@@ -109,9 +163,64 @@ void rcvr_mmc (
 	UINT bc		/* Number of bytes to receive */
 )
 {
-	do {
-		*buff++ = (BYTE) SPI_ReceiveByte();			/* Store a received byte */
-	} while (--bc);
+	SPI_ReceiveBlock(buff, bc);	/* Pipelined: next dummy byte sent before storing the current one */
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Measure a wait with Timer2                                            */
+/*-----------------------------------------------------------------------*/
+/* The waits poll the card continuously and read Timer2 after every byte,
+/  far more often than its 1.024ms wrap period, so no interrupt is needed. */
+
+static
+void tmr_start (void)
+{
+	TmrLast = TMR_READ();
+	TmrCount = 0;
+}
+
+static
+DWORD tmr_elapsed (void)	/* Timer2 counts since tmr_start() */
+{
+	BYTE t = TMR_READ();
+
+
+	TmrCount += (BYTE)(t - TmrLast);
+	TmrLast = t;
+
+	return TmrCount;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Time base of the non-blocking write                                   */
+/*-----------------------------------------------------------------------*/
+/* mmc_write_poll() may be called far apart, so while a non-blocking write
+/  is pending TIMER2_OVF_vect counts the Timer2 wraps. Needs the global
+/  interrupt enable. */
+
+ISR(TIMER2_OVF_vect)
+{
+	TmrWraps++;
+}
+
+static
+DWORD tmr_now (void)	/* Timer2 counts, with the wraps */
+{
+	DWORD w;
+	BYTE t, sreg = SREG;
+
+
+	cli();
+	w = TmrWraps;
+	t = TMR_READ();
+	if (TMR_WRAPPED() && t < 128) w++;	/* Wrapped, TIMER2_OVF_vect not run yet */
+	SREG = sreg;
+
+	return (w << 8) | t;
 }
 
 
@@ -121,19 +230,20 @@ void rcvr_mmc (
 /*-----------------------------------------------------------------------*/
 
 static
-int wait_ready (void)	/* 1:OK, 0:Timeout */
+int wait_ready (	/* 1:OK, 0:Timeout */
+	UINT wt			/* Timeout [ms] */
+)
 {
 	BYTE d;
-	UINT tmr;
 
 
-	for (tmr = 5000; tmr; tmr--) {	/* Wait for ready in timeout of 500ms */
+	tmr_start();
+	do
 		rcvr_mmc(&d, 1);
-		if (d == 0xFF) break;
-		DLY_US(100);
-	}
+	while (d != 0xFF && tmr_elapsed() < (DWORD)wt * TMR_MS);	/* Wait for ready */
+	MMC_STATS_WAIT(TmrCount * 10 / TMR_MS, d != 0xFF);	/* Charged to what left the card busy */
 
-	return tmr ? 1 : 0;
+	return (d == 0xFF) ? 1 : 0;
 }
 
 
@@ -165,7 +275,7 @@ int select (void)	/* 1:OK, 0:Timeout */
 	CS_L();
 	rcvr_mmc(&d, 1);	/* Dummy clock (force DO enabled) */
 
-	if (wait_ready()) return 1;	/* OK */
+	if (wait_ready(READY_MS)) return 1;	/* OK */
 	deselect();
 	return 0;	/* Timeout */
 }
@@ -183,15 +293,17 @@ int rcvr_datablock (	/* 1:OK, 0:Failed */
 )
 {
 	BYTE d[2];
-	UINT tmr;
 
 
-	for (tmr = 1000; tmr; tmr--) {	/* Wait for data packet in timeout of 100ms */
+	tmr_start();
+	do
 		rcvr_mmc(d, 1);
-		if (d[0] != 0xFF) break;
-		DLY_US(100);
+	while (d[0] == 0xFF && tmr_elapsed() < TOKEN_MS * TMR_MS);	/* Wait for data packet */
+	MMC_STATS_RECORD(MMC_STATS_READ, TmrCount * 10 / TMR_MS, d[0] == 0xFF);
+	if (d[0] != 0xFE) {				/* If not valid data token, return with error */
+		if (d[0] != 0xFF) MMC_STATS_ERROR(MMC_STATS_READ_ERROR);
+		return 0;
 	}
-	if (d[0] != 0xFE) return 0;		/* If not valid data token, return with error */
 
 	rcvr_mmc(buff, btr);			/* Receive the data block into buffer */
 	rcvr_mmc(d, 2);					/* Discard CRC */
@@ -214,7 +326,7 @@ int xmit_datablock (	/* 1:OK, 0:Failed */
 	BYTE d[2];
 
 
-	if (!wait_ready()) return 0;
+	if (!wait_ready(READY_MS)) return 0;
 
 	d[0] = token;
 	xmit_mmc(d, 1);				/* Xmit a token */
@@ -222,8 +334,13 @@ int xmit_datablock (	/* 1:OK, 0:Failed */
 		xmit_mmc(buff, 512);	/* Xmit the 512 byte data block to MMC */
 		rcvr_mmc(d, 2);			/* Dummy CRC (FF,FF) */
 		rcvr_mmc(d, 1);			/* Receive data response */
-		if ((d[0] & 0x1F) != 0x05)	/* If not accepted, return with error */
+		if ((d[0] & 0x1F) != 0x05) {	/* If not accepted, return with error */
+			MMC_STATS_ERROR(MMC_STATS_REJECTED);
 			return 0;
+		}
+		MMC_STATS_BUSY(token == 0xFE ? MMC_STATS_WRITE : MMC_STATS_MULTI);
+	} else {
+		MMC_STATS_BUSY(MMC_STATS_STOP);
 	}
 
 	return 1;
@@ -272,12 +389,233 @@ BYTE send_cmd (		/* Returns command response (bit7==1:Send failed)*/
 	do
 		rcvr_mmc(&d, 1);
 	while ((d & 0x80) && --n);
+	if (d & 0x80) MMC_STATS_ERROR(MMC_STATS_NO_RESPONSE);
+	else if (d & 0x78) MMC_STATS_ERROR(MMC_STATS_R1_ERROR);	/* CRC, erase sequence, address or parameter error */
 
 	return d;			/* Return with the response value */
 }
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Read a sector and check its CRC16                                     */
+/*-----------------------------------------------------------------------*/
+/* The data block is received in small pieces so that no sector buffer is
+/  needed. In SPI mode the card sends a valid CRC16 with every data block
+/  even when CRC checking is off. */
+
+static
+int test_clock (void)	/* 1:Sector 0 read back with a valid CRC, 0:Failed */
+{
+	BYTE d[16], n, i, token;
+	WORD crc = 0;
+
+
+	if (send_cmd(CMD17, 0) != 0) {	/* READ_SINGLE_BLOCK */
+		deselect();
+		return 0;
+	}
+	tmr_start();
+	do
+		rcvr_mmc(d, 1);
+	while (d[0] == 0xFF && tmr_elapsed() < TOKEN_MS * TMR_MS);	/* Wait for data packet */
+	token = d[0];
+	if (token == 0xFF) {			/* No data packet */
+		deselect();
+		return 0;
+	}
+	for (n = 512 / sizeof d; n; n--) {	/* Whole packet even if the token was garbled */
+		rcvr_mmc(d, sizeof d);
+		for (i = 0; i < sizeof d; i++) crc = _crc_xmodem_update(crc, d[i]);
+	}
+	rcvr_mmc(d, 2);
+	deselect();
+
+	return token == 0xFE && crc == (((WORD)d[0] << 8) | d[1]);
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Negotiate the SPI clock                                               */
+/*-----------------------------------------------------------------------*/
+/* Starts at the fastest divider within the TRAN_SPEED of the CSD and
+/  SCK_MAX_KHZ, and takes one step slower while the self-test fails. */
+
+static
+BYTE set_clock (void)	/* Returns the divider set (128 if every step failed) */
+{
+	static const BYTE tv[16] PROGMEM = {0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80};	/* TRAN_SPEED time value x10 */
+	BYTE csd[16], div, n;
+	DWORD khz, lim = SCK_MAX_KHZ;
+
+
+	if ((send_cmd(CMD9, 0) == 0) && rcvr_datablock(csd, 16)) {	/* TRAN_SPEED: csd[3] */
+		khz = pgm_read_byte(&tv[(csd[3] >> 3) & 15]) * 10;			/* kHz for the 100kbit/s unit */
+		for (n = csd[3] & 7; n; n--) khz *= 10;
+		if (khz < lim) lim = khz;
+	}
+	deselect();
+
+	for (div = 2; div < 128 && F_CPU / 1000 / div > lim; div <<= 1) ;
+	for ( ; div < 128; div <<= 1) {
+		SPI_CLK_SET(div);
+		for (n = CLK_TESTS; n && test_clock(); n--) ;
+		if (!n) return div;
+	}
+	SPI_CLK_LOW;
+
+	return 128;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get the allocation unit and erase parameters                          */
+/*-----------------------------------------------------------------------*/
+/* SDv2 cards report them in the SD status (ACMD13); on SDv1 and MMCv3 the
+/  erase block size of the CSD stands for the AU and the other fields are
+/  not available. */
+
+static
+int get_erase_info (	/* 1:OK, 0:Failed */
+	DWORD *info			/* AU size (sectors), erase size (AUs), erase timeout (s), erase offset (s) */
+)
+{
+	BYTE d[16], n;
+
+
+	info[0] = info[1] = info[2] = info[3] = 0;
+	if (CardType & CT_SD2) {	/* SDv2: SD status */
+		if (send_cmd(ACMD13, 0) == 0) {
+			rcvr_mmc(d, 1);							/* Second byte of the R2 response */
+			if (rcvr_datablock(d, 16)) {			/* First 16 of the 64 bytes (and 2 more as "CRC") */
+				for (n = 64 - 16; n; n--) rcvr_mmc(d + 15, 1);	/* Purge trailing data and CRC */
+				n = d[10] >> 4;						/* AU_SIZE */
+				if (n && n <= 9) info[0] = 16UL << n;	/* 16KB..4MB */
+				if (n > 9) info[0] = (n == 15) ? 131072UL : (DWORD)(2 + (n & 1)) << (13 + (n - 10) / 2);	/* SDXC: 8, 12, 16, 24, 32, 64MB */
+				info[1] = ((WORD)d[11] << 8) | d[12];	/* ERASE_SIZE */
+				info[2] = d[13] >> 2;				/* ERASE_TIMEOUT */
+				info[3] = d[13] & 3;				/* ERASE_OFFSET */
+			}
+		}
+		deselect();
+		if (info[0]) return 1;	/* AU_SIZE 0 (not defined): use the CSD */
+	}
+	if ((send_cmd(CMD9, 0) == 0) && rcvr_datablock(d, 16)) {	/* Read CSD */
+		if (CardType & CT_SDC) {	/* SDC: (SECTOR_SIZE + 1) write blocks */
+			info[0] = (((d[10] & 63) << 1) + ((WORD)(d[11] & 128) >> 7) + 1) << ((d[13] >> 6) - 1);
+		} else {					/* MMCv3: (ERASE_GRP_SIZE + 1) * (ERASE_GRP_MULT + 1) */
+			info[0] = ((WORD)((d[10] & 124) >> 2) + 1) * (((d[11] & 3) << 3) + ((d[11] & 224) >> 5) + 1);
+		}
+	}
+	deselect();
+
+	return info[0] != 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Advance the non-blocking write                                        */
+/*-----------------------------------------------------------------------*/
+/* Each call polls the card once or moves to the next state, and never
+/  waits for the card. The card is deselected between polls. The busy time
+/  is measured with tmr_now() from the entry in WS_READY or WS_PROGRAM. */
+
+static
+int write_step (void)	/* 1:Card busy, 0:Progress or no write */
+{
+	BYTE d;
+	DWORD sect, t;
+
+
+	switch (WrState) {
+	case WS_READY:
+	case WS_PROGRAM:
+		CS_L();
+		rcvr_mmc(&d, 1);
+		t = tmr_now() - WrStart;
+		if (d != 0xFF) {				/* Busy */
+			deselect();
+			if (t < READY_MS * TMR_MS) return 1;
+			MMC_STATS_WAIT(t * 10 / TMR_MS, 1);
+			break;						/* Timeout */
+		}
+		MMC_STATS_WAIT(t * 10 / TMR_MS, 0);
+		if (WrState == WS_PROGRAM) {	/* Sector programmed */
+			deselect();
+			TMR_TICK_OFF();
+			WrState = WS_IDLE;
+			return 0;
+		}
+		if (WrOpen && WrTarget != WrSector) {	/* Leave the write session, then wait again */
+			d = 0xFD;
+			xmit_mmc(&d, 1);			/* STOP_TRAN token */
+			deselect();
+			MMC_STATS_BUSY(MMC_STATS_STOP);
+			WrOpen = 0;
+			WrStart = tmr_now();
+			return 0;
+		}
+		if (WrOpen) {					/* Next sector of the write session */
+			if (!xmit_datablock(WrBuff, 0xFC)) break;
+			WrSector++;
+			if (WrLeft) WrLeft--;
+		} else {
+			sect = WrTarget;
+			if (!(CardType & CT_BLOCK)) sect *= 512;	/* Convert LBA to byte address if needed */
+			if (send_cmd(CMD24, sect) != 0) break;		/* WRITE_BLOCK */
+			if (!xmit_datablock(WrBuff, 0xFE)) break;
+		}
+		deselect();
+		WrState = WS_PROGRAM;
+		WrStart = tmr_now();
+		return 0;
+
+	default:
+		return 0;
+	}
+
+	deselect();
+	TMR_TICK_OFF();
+	WrState = WS_FAILED;
+	if (WrOpen) mmc_write_close();	/* Rejected in the write session: end it */
+	return 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Close the write session before another access                         */
+/*-----------------------------------------------------------------------*/
+/* A session opened with a pre-erase count must be filled first: closing it
+/  early would leave pre-erased sectors with undefined contents. */
+
+static
+int leave_session (void)	/* 1:No session open, 0:Pre-erased sectors left or failed */
+{
+	if (WrLeft) return 0;
+	return mmc_write_close() == RES_OK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Finish the non-blocking write before a blocking access                */
+/*-----------------------------------------------------------------------*/
+/* Runs the non-blocking write to its end; its result stays for
+/  mmc_write_poll(). The card is polled back to back, and write_step()
+/  times the wait with Timer2 and records it. */
+
+static
+void wait_write (void)
+{
+	while (WrState != WS_IDLE && WrState != WS_FAILED) write_step();
+}
+
+
+
 /*--------------------------------------------------------------------------
 
    Public Functions
@@ -313,27 +651,39 @@ DSTATUS disk_initialize (
 
 
 	INIT_PORT();				/* Initialize control port */
+	TMR_INIT();					/* Time base of the timeouts */
 	SPI_CLK_LOW;
+	WrOpen = 0;					/* A power cycle drops any write session */
+	WrLeft = 0;
+	WrState = WS_IDLE;
 
 	s = disk_status(drv);		/* Check if card is in the socket */
 	if (s & STA_NODISK) return s;
 
 	CS_H();
 	for (n = 10; n; n--) rcvr_mmc(buf, 1);	/* 80 dummy clocks */
+	BOOT_MARK(BOOT_EVENT_SD_POWER_UP, 0);
 
 	ty = 0;
-	if (send_cmd(CMD0, 0) == 1) {			/* Enter Idle state */
-		if (send_cmd(CMD8, 0x1AA) == 1) {	/* SDv2? */
+	n = send_cmd(CMD0, 0);
+	BOOT_MARK(BOOT_EVENT_SD_COMMAND, CMD0);
+	if (n == 1) {			/* Enter Idle state */
+		n = send_cmd(CMD8, 0x1AA);
+		BOOT_MARK(BOOT_EVENT_SD_COMMAND, CMD8);
+		if (n == 1) {	/* SDv2? */
 			rcvr_mmc(buf, 4);							/* Get trailing return value of R7 resp */
 			if (buf[2] == 0x01 && buf[3] == 0xAA) {		/* The card can work at vdd range of 2.7-3.6V */
 				for (tmr = 1000; tmr; tmr--) {			/* Wait for leaving idle state (ACMD41 with HCS bit) */
-					if (send_cmd(ACMD41, 1UL << 30) == 0) break;
+					n = send_cmd(ACMD41, 1UL << 30);
+					BOOT_MARK(BOOT_EVENT_SD_COMMAND, ACMD41);
+					if (n == 0) break;
 					DLY_US(1000);
 				}
 				if (tmr && send_cmd(CMD58, 0) == 0) {	/* Check CCS bit in the OCR */
 					rcvr_mmc(buf, 4);
 					ty = (buf[0] & 0x40) ? CT_SD2 | CT_BLOCK : CT_SD2;	/* SDv2 */
 				}
+				BOOT_MARK(BOOT_EVENT_SD_COMMAND, CMD58);
 			}
 		} else {							/* SDv1 or MMCv3 */
 			if (send_cmd(ACMD41, 0) <= 1) 	{
@@ -341,12 +691,16 @@ DSTATUS disk_initialize (
 			} else {
 				ty = CT_MMC; cmd = CMD1;	/* MMCv3 */
 			}
+			BOOT_MARK(BOOT_EVENT_SD_COMMAND, ACMD41);
 			for (tmr = 1000; tmr; tmr--) {			/* Wait for leaving idle state */
-				if (send_cmd(cmd, 0) == 0) break;
+				n = send_cmd(cmd, 0);
+				BOOT_MARK(BOOT_EVENT_SD_COMMAND, cmd);
+				if (n == 0) break;
 				DLY_US(1000);
 			}
 			if (!tmr || send_cmd(CMD16, 512) != 0)	/* Set R/W block length to 512 */
 				ty = 0;
+			BOOT_MARK(BOOT_EVENT_SD_COMMAND, CMD16);
 		}
 	}
 	CardType = ty;
@@ -358,7 +712,11 @@ DSTATUS disk_initialize (
 
 	deselect();
 
-	SPI_CLK_FAST;
+	if (ty) {
+		n = set_clock();		/* Fastest clock the card and the wiring carry */
+		BOOT_MARK(BOOT_EVENT_SD_CLOCK, n);
+	}
+	BOOT_MARK(BOOT_EVENT_SD_READY, ty);
 
 	return s;
 }
@@ -382,6 +740,7 @@ DRESULT disk_read (
 	s = disk_status(drv);
 	if (s & STA_NOINIT) return RES_NOTRDY;
 	if (!count) return RES_PARERR;
+	if (!leave_session()) return RES_ERROR;
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert LBA to byte address if needed */
 
 	if (count == 1) {	/* Single block read */
@@ -423,6 +782,16 @@ DRESULT disk_write (
 	if (s & STA_NOINIT) return RES_NOTRDY;
 	if (s & STA_PROTECT) return RES_WRPRT;
 	if (!count) return RES_PARERR;
+
+	if (WrOpen && sector == WrSector) {	/* Appends to the write session */
+		do {
+			if (mmc_write_sector(buff) != RES_OK) return RES_ERROR;
+			buff += 512;
+		} while (--count);
+		return RES_OK;
+	}
+	if (!leave_session()) return RES_ERROR;
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert LBA to byte address if needed */
 
 	if (count == 1) {	/* Single block write */
@@ -461,14 +830,18 @@ DRESULT disk_ioctl (
 	DRESULT res;
 	BYTE n, csd[16];
 	WORD cs;
+	DWORD info[4], *dp, st, ed;
 
 
 	if (disk_status(drv) & STA_NOINIT)					/* Check if card is in the socket */
 		return RES_NOTRDY;
 
+	wait_write();										/* Non-blocking write, if any */
 	res = RES_ERROR;
+	if (ctrl != CTRL_SYNC && !leave_session())			/* Commands end the write session */
+		return res;
 	switch (ctrl) {
-		case CTRL_SYNC :		/* Make sure that no pending write process */
+		case CTRL_SYNC :		/* Make sure that no pending write process (an open write session stays open) */
 			if (select()) {
 				deselect();
 				res = RES_OK;
@@ -490,8 +863,28 @@ DRESULT disk_ioctl (
 			break;
 
 		case GET_BLOCK_SIZE :	/* Get erase block size in unit of sector (DWORD) */
-			*(DWORD*)buff = 128;
-			res = RES_OK;
+			if (get_erase_info(info)) {
+				*(DWORD*)buff = info[0];
+				res = RES_OK;
+			}
+			break;
+
+		case CTRL_ERASE_SECTOR :	/* Erase a block of sectors (DWORD[2]: start and end sector) */
+			if (!(CardType & CT_SDC)) break;				/* Check if the card is SDC */
+			if ((send_cmd(CMD9, 0) != 0) || !rcvr_datablock(csd, 16)) break;	/* Get CSD */
+			if (!(csd[0] >> 6) && !(csd[10] & 0x40)) break;	/* Check if sector erase can be applied to the card */
+			dp = buff; st = dp[0]; ed = dp[1];				/* Load sector block */
+			if (!(CardType & CT_BLOCK)) {
+				st *= 512; ed *= 512;
+			}
+			if (send_cmd(CMD32, st) == 0 && send_cmd(CMD33, ed) == 0 && send_cmd(CMD38, 0) == 0) {	/* Erase sector block */
+				MMC_STATS_BUSY(MMC_STATS_ERASE);
+				if (wait_ready(ERASE_MS)) res = RES_OK;	/* Erase takes up to ERASE_TIMEOUT per ERASE_SIZE AUs */
+			}
+			break;
+
+		case MMC_GET_ERASE_INFO :	/* Get AU size (sectors), erase size (AUs), erase timeout and offset (s) (DWORD[4]) */
+			if (get_erase_info(buff)) res = RES_OK;
 			break;
 
 		default:
@@ -503,3 +896,142 @@ DRESULT disk_ioctl (
 	return res;
 }
 
+
+
+/*-----------------------------------------------------------------------*/
+/* Open a write session                                                  */
+/*-----------------------------------------------------------------------*/
+/* The session is an open-ended CMD25 (WRITE_MULTIPLE_BLOCK) that stays open
+/  between calls, so that a logger appending one sector at a time pays the
+/  command and the stop token once instead of a CMD24 per sector. The card
+/  is deselected between sectors. disk_write() calls that continue at the
+/  next sector of the session go through it; any other disk access closes
+/  it first.
+/  A count pre-erases that many sectors with ACMD23 on SDC, and the caller
+/  promises to write all of them: until then any other access fails with
+/  RES_ERROR and leaves the session open, and mmc_write_close() returns
+/  RES_ERROR as the sectors not written hold undefined data. Pass 0 when
+/  the length of the run is not known. */
+
+DRESULT mmc_write_open (
+	DWORD sector,		/* Start sector number (LBA) */
+	DWORD count			/* Sectors that will be written, pre-erased with ACMD23 on SDC (0:unknown) */
+)
+{
+	if (Stat & STA_NOINIT) return RES_NOTRDY;
+	if (Stat & STA_PROTECT) return RES_WRPRT;
+	if (!leave_session()) return RES_ERROR;
+
+	WrSector = sector;
+	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert LBA to byte address if needed */
+
+	if (count && (CardType & CT_SDC) && send_cmd(ACMD23, count) == 0)
+		WrLeft = count;
+	if (send_cmd(CMD25, sector) == 0)	/* WRITE_MULTIPLE_BLOCK */
+		WrOpen = 1;
+	else
+		WrLeft = 0;
+	deselect();
+
+	return WrOpen ? RES_OK : RES_ERROR;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write a sector into the write session                                 */
+/*-----------------------------------------------------------------------*/
+
+DRESULT mmc_write_sector (
+	const BYTE *buff	/* Pointer to the 512 byte sector to be written */
+)
+{
+	wait_write();
+	if (!WrOpen) return RES_PARERR;
+
+	if (select() && xmit_datablock(buff, 0xFC)) {
+		deselect();
+		WrSector++;
+		if (WrLeft) WrLeft--;
+		return RES_OK;
+	}
+	deselect();
+	mmc_write_close();	/* Rejected: end the session */
+
+	return RES_ERROR;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Close the write session                                               */
+/*-----------------------------------------------------------------------*/
+
+DRESULT mmc_write_close (void)
+{
+	int ok;
+
+
+	wait_write();
+	if (!WrOpen) return RES_OK;
+	WrOpen = 0;
+
+	ok = select() && xmit_datablock(0, 0xFD);	/* STOP_TRAN token */
+	deselect();
+	if (WrLeft) ok = 0;						/* Pre-erased sectors left unwritten */
+	WrLeft = 0;
+
+	return ok ? RES_OK : RES_ERROR;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Start a non-blocking write                                            */
+/*-----------------------------------------------------------------------*/
+/* Writes one sector without waiting for the card: mmc_write_poll(),
+/  called from the main loop, waits for the card to be ready, sends the
+/  data block and polls the programming busy time, which
+/  may take hundreds of milliseconds on a slow card. The sector continues
+/  the write session if one is open at it, else it is a CMD24. The buffer
+/  must not change until mmc_write_poll() returns WR_DONE or WR_ERROR.
+/  The blocking functions of this module run a pending write to its end
+/  first. The logger itself still writes through FatFs, which needs
+/  disk_write() to finish before it returns. */
+
+DRESULT mmc_write_start (
+	const BYTE *buff,	/* Pointer to the 512 byte sector to be written */
+	DWORD sector		/* Sector number (LBA) */
+)
+{
+	if (Stat & STA_NOINIT) return RES_NOTRDY;
+	if (Stat & STA_PROTECT) return RES_WRPRT;
+	if (WrState != WS_IDLE && WrState != WS_FAILED) return RES_NOTRDY;	/* Previous write still running */
+	if (WrLeft && sector != WrSector) return RES_ERROR;	/* Would leave a pre-erased session */
+
+	WrBuff = buff;
+	WrTarget = sector;
+	WrState = WS_READY;
+	TMR_TICK_ON();
+	WrStart = tmr_now();
+	write_step();
+
+	return RES_OK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Poll the non-blocking write                                           */
+/*-----------------------------------------------------------------------*/
+/* The busy timeout is the READY_MS of the blocking functions, timed with
+/  the Timer2 wraps, so the calls may be any distance apart. An error stays
+/  reported until the next mmc_write_start(). */
+
+WRSTAT mmc_write_poll (void)
+{
+	if (WrState != WS_IDLE && WrState != WS_FAILED) write_step();
+
+	if (WrState == WS_IDLE) return WR_DONE;
+	if (WrState == WS_FAILED) return WR_ERROR;
+	return WR_BUSY;
+}
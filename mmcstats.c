@@ -0,0 +1,173 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			mmcstats.c
+ * Module:			SD card latency statistics
+ * Purpose:			Keeps log-2 histograms of how long mmc.c waits for the
+ *					card, per kind of wait, and counts timeouts and rejected
+ *					responses, reported over the USART or into a file on the SD
+ *					card
+ * -------------------------------------------------------------------------- */
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "mmcstats.h"
+#if __MMCSTATS_H != 10
+	#error Error 101 - Version mismatch on header and source code files (mmcStats).
+#endif
+
+#ifdef MMC_STATS
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "globalDefines.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define MMC_STATS_LINE				(16 + 6 * MMC_STATS_BUCKETS)
+#define MMC_STATS_HEADER_LINES		2
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+uint8_t mmcStatsPending = MMC_STATS_READY;
+mmcStatsHistogram_t mmcStatsHistograms[MMC_STATS_WAITS];
+uint16_t mmcStatsErrors[MMC_STATS_ERRORS];
+
+// -----------------------------------------------------------------------------
+// Private function definitions ------------------------------------------------
+
+static PGM_P mmcStatsName(uint8_t wait)
+{
+	switch(wait){
+	case MMC_STATS_READY:	return PSTR("ready");
+	case MMC_STATS_WRITE:	return PSTR("write");
+	case MMC_STATS_MULTI:	return PSTR("multi");
+	case MMC_STATS_STOP:	return PSTR("stop");
+	case MMC_STATS_ERASE:	return PSTR("erase");
+	case MMC_STATS_READ:	return PSTR("read");
+	default:				return PSTR("?");
+	}
+}
+
+/* Two lines per kind of wait: totals, then the buckets */
+static uint8_t mmcStatsLine(uint8_t line, char * buffer)
+{
+	const mmcStatsHistogram_t * histogram;
+	char name[8];
+	uint32_t count = 0;
+	uint8_t length, i;
+
+	buffer[0] = '\0';
+	switch(line){
+	case 0:
+		snprintf_P(buffer, MMC_STATS_LINE, PSTR("SD card waits (100 us): kind count avg max timeouts"));
+		return 1;
+	case 1:
+		snprintf_P(buffer, MMC_STATS_LINE, PSTR("  errors: no response %u, R1 %u, rejected %u, read %u"),
+			mmcStatsErrors[MMC_STATS_NO_RESPONSE], mmcStatsErrors[MMC_STATS_R1_ERROR],
+			mmcStatsErrors[MMC_STATS_REJECTED], mmcStatsErrors[MMC_STATS_READ_ERROR]);
+		return 1;
+	}
+	line -= MMC_STATS_HEADER_LINES;
+	if(line >= 2 * MMC_STATS_WAITS)
+		return 0;
+
+	histogram = &mmcStatsHistograms[line / 2];
+	for(i = 0; i < MMC_STATS_BUCKETS; i++)
+		count += histogram->buckets[i];
+	if(!count)
+		return 1;
+	if(!(line & 1)){
+		strcpy_P(name, mmcStatsName(line / 2));
+		snprintf_P(buffer, MMC_STATS_LINE, PSTR("  %-6s %6lu %5lu %6lu %4u"), name, (unsigned long)count,
+			(unsigned long)(histogram->timeSum / count), (unsigned long)histogram->timeMax, histogram->timeouts);
+	}else{
+		length = snprintf_P(buffer, MMC_STATS_LINE, PSTR("   "));
+		for(i = 0; i < MMC_STATS_BUCKETS; i++)
+			length += snprintf_P(buffer + length, MMC_STATS_LINE - length, PSTR(" %u"), histogram->buckets[i]);
+	}
+	return 1;
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	mmcStatsRecord
+ * Purpose:		Adds a wait to the histogram of its kind
+ * Arguments:	wait		Kind of wait
+ *				time		Time until the card answered (100 us units)
+ *				timeout		1 when the card never answered
+ * Returns:		none
+ * Notes:		Called from the main loop only (mmc.c is not used by ISRs)
+ * -------------------------------------------------------------------------- */
+
+void mmcStatsRecord(mmcStatsWait_t wait, uint32_t time, uint8_t timeout)
+{
+	mmcStatsHistogram_t * histogram = &mmcStatsHistograms[wait];
+	uint8_t bucket = 0;
+
+	while(time >> bucket)
+		bucket++;
+	if(bucket >= MMC_STATS_BUCKETS)
+		bucket = MMC_STATS_BUCKETS - 1;
+	if(histogram->buckets[bucket] != 0xFFFF)
+		histogram->buckets[bucket]++;
+	if(timeout && (histogram->timeouts != 0xFFFF))
+		histogram->timeouts++;
+	histogram->timeSum += time;
+	if(time > histogram->timeMax)
+		histogram->timeMax = time;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	mmcStatsPrint
+ * Purpose:		Prints the statistics since reset
+ * Arguments:	none
+ * Returns:		none
+ * Notes:		Uses printf, so the USART must already be bound to stdout
+ * -------------------------------------------------------------------------- */
+
+void mmcStatsPrint(void)
+{
+	char buffer[MMC_STATS_LINE];
+	uint8_t line;
+
+	for(line = 0; mmcStatsLine(line, buffer); line++){
+		if(buffer[0])
+			printf_P(PSTR("%s\n\r"), buffer);
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	mmcStatsDump
+ * Purpose:		Appends the statistics to a file
+ * Arguments:	path		File name
+ * Returns:		FatFs result code
+ * Notes:		The volume must be mounted. The accesses of the dump itself
+ *				are counted too
+ * -------------------------------------------------------------------------- */
+
+FRESULT mmcStatsDump(const TCHAR * path)
+{
+	char buffer[MMC_STATS_LINE];
+	uint8_t line;
+	FRESULT result;
+	FIL file;
+
+	result = f_open(&file, path, FA_WRITE | FA_OPEN_ALWAYS);
+	if(result != FR_OK)
+		return result;
+	result = f_lseek(&file, f_size(&file));
+	for(line = 0; (result == FR_OK) && mmcStatsLine(line, buffer); line++){
+		if(buffer[0] && (f_printf(&file, "%s\n", buffer) == EOF))
+			result = FR_DISK_ERR;
+	}
+	if(f_close(&file) != FR_OK)
+		result = FR_DISK_ERR;
+	return result;
+}
+
+#endif
@@ -0,0 +1,97 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			mmcstats.h
+ * Module:			SD card latency statistics
+ * Purpose:			Keeps log-2 histograms of how long mmc.c waits for the
+ *					card, per kind of wait, and counts timeouts and rejected
+ *					responses, reported over the USART or into a file on the SD
+ *					card
+ * Notes:			Compiled in only when MMC_STATS is defined; otherwise the
+ *					macros below expand to empty expressions. Waits are
+ *					measured in units of 100 us with the Timer2 time base of
+ *					mmc.c, also for the non-blocking write, which adds the
+ *					Timer2 wraps counted by TIMER2_OVF_vect.
+ *					Bucket 0 holds the waits shorter than one unit and bucket
+ *					n the waits of 2^(n-1) to 2^n - 1 units; the last bucket
+ *					also holds the longer ones. The card programs a
+ *					sector after the data response, and the wait shows up at
+ *					the next wait_ready(), so mmc.c marks what left the card
+ *					busy (MMC_STATS_BUSY) and the next wait is charged to it
+ * -------------------------------------------------------------------------- */
+
+#ifndef __MMCSTATS_H
+#define __MMCSTATS_H 10
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include <stdint.h>
+#include "ff.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define MMC_STATS_BUCKETS			16		// Last bucket: 1.6 s and longer
+
+#ifndef MMC_STATS_PERIOD
+	#define MMC_STATS_PERIOD		360		// Records between reports (1 hour)
+#endif
+
+#ifndef MMC_STATS_FILE
+	#define MMC_STATS_FILE			"Cartao.txt"
+#endif
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef enum mmcStatsWait_t{
+	MMC_STATS_READY = 0,			// Nothing pending (power-up, command busy)
+	MMC_STATS_WRITE,				// Programming a CMD24 sector
+	MMC_STATS_MULTI,				// Programming a CMD25 sector
+	MMC_STATS_STOP,					// Ending a CMD25 session (stop token)
+	MMC_STATS_ERASE,				// CMD38
+	MMC_STATS_READ,					// Data token of a read (Nac)
+	MMC_STATS_WAITS
+} mmcStatsWait_t;
+
+typedef enum mmcStatsError_t{
+	MMC_STATS_NO_RESPONSE = 0,		// No R1 within 10 bytes
+	MMC_STATS_R1_ERROR,				// R1 with CRC, erase sequence, address or parameter error
+	MMC_STATS_REJECTED,				// Data response other than "data accepted"
+	MMC_STATS_READ_ERROR,			// Error token instead of a data token
+	MMC_STATS_ERRORS
+} mmcStatsError_t;
+
+typedef struct mmcStatsHistogram_t{
+	uint16_t	buckets[MMC_STATS_BUCKETS];	// Saturate at 0xFFFF
+	uint16_t	timeouts;
+	uint32_t	timeSum;				// 100 us units
+	uint32_t	timeMax;
+} mmcStatsHistogram_t;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+#ifdef MMC_STATS
+	extern uint8_t mmcStatsPending;
+	extern mmcStatsHistogram_t mmcStatsHistograms[MMC_STATS_WAITS];
+	extern uint16_t mmcStatsErrors[MMC_STATS_ERRORS];
+
+	void	mmcStatsRecord(mmcStatsWait_t wait, uint32_t time, uint8_t timeout);
+	void	mmcStatsPrint(void);
+	FRESULT	mmcStatsDump(const TCHAR * path);
+
+	#define MMC_STATS_BUSY(wait)				(mmcStatsPending = (wait))
+	#define MMC_STATS_WAIT(time, timeout)		do{ mmcStatsRecord(mmcStatsPending, (time), (timeout)); mmcStatsPending = MMC_STATS_READY; }while(0)
+	#define MMC_STATS_RECORD(wait, time, timeout)	mmcStatsRecord((wait), (time), (timeout))
+	#define MMC_STATS_ERROR(error)				do{ if(mmcStatsErrors[error] != 0xFFFF) mmcStatsErrors[error]++; }while(0)
+#else
+	#define mmcStatsPrint()						((void)0)
+	#define mmcStatsDump(path)					FR_OK
+	#define MMC_STATS_BUSY(wait)				((void)0)
+	#define MMC_STATS_WAIT(time, timeout)		((void)0)
+	#define MMC_STATS_RECORD(wait, time, timeout)	((void)0)
+	#define MMC_STATS_ERROR(error)				((void)0)
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			ramusage.c
+ * Module:			RAM usage report
+ * Purpose:			Paints the free SRAM at reset and reports the static usage
+ *					(.data/.bss, per module) and the deepest stack excursion
+ *					over the USART or into a file on the SD card
+ * -------------------------------------------------------------------------- */
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "ramusage.h"
+#if __RAMUSAGE_H != 10
+	#error Error 101 - Version mismatch on header and source code files (ramUsage).
+#endif
+
+#ifdef RAM_USAGE
+
+#include <avr/pgmspace.h>
+#include "globalDefines.h"
+#include "sensor.h"
+#include "twimaster.h"
+#include "ds1307.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define RAM_USAGE_LINE				40
+
+#ifndef HOST_BUILD
+// -----------------------------------------------------------------------------
+// External symbols ------------------------------------------------------------
+
+/* Section boundaries from the avr-libc linker script */
+extern uint8_t __data_start, __data_end;
+extern uint8_t __bss_start, __bss_end;
+extern uint8_t __stack;
+#endif
+
+// -----------------------------------------------------------------------------
+// Stack painting --------------------------------------------------------------
+
+#ifndef HOST_BUILD
+/* Runs from .init1, before __zero_reg__ and the stack pointer are set up by the
+ * C runtime, so it cannot be C code: fills __bss_end..__stack with the paint */
+void ramUsagePaint(void) __attribute__((naked, used, section(".init1")));
+void ramUsagePaint(void)
+{
+	__asm volatile(
+		"	ldi r30, lo8(__bss_end)		\n"
+		"	ldi r31, hi8(__bss_end)		\n"
+		"	ldi r24, %0					\n"
+		"	ldi r25, hi8(__stack)		\n"
+		"	rjmp 2f						\n"
+		"1:	st Z+, r24					\n"
+		"2:	cpi r30, lo8(__stack)		\n"
+		"	cpc r31, r25				\n"
+		"	brlo 1b						\n"
+		"	breq 1b						\n"
+		:: "M" (RAM_USAGE_PAINT));
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Private function definitions ------------------------------------------------
+
+static uint8_t ramUsageLine(const ramUsage_t * usage, uint8_t line, char * buffer)
+{
+	switch(line){
+	case 0:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("RAM usage (bytes of %u):"), usage->size); break;
+#ifndef HOST_BUILD
+	case 1:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  .data      %5u"), usage->dataBytes); break;
+	case 2:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  .bss       %5u"), usage->bssBytes); break;
+	case 3:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  stack peak %5u (now %u)"), usage->stackPeak, usage->stackNow); break;
+	case 4:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  headroom   %5u"), usage->headroom); break;
+#endif
+	case 5:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  sensor     %5u"), usage->sensor); break;
+	case 6:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  twi master %5u"), usage->twiMaster); break;
+	case 7:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  ds1307     %5u"), usage->ds1307); break;
+#ifndef HOST_BUILD
+	case 8:		snprintf_P(buffer, RAM_USAGE_LINE, PSTR("  others     %5u"), usage->others); break;
+#endif
+	case 9:		return 0;
+	default:	buffer[0] = '\0'; break;
+	}
+	return 1;
+}
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	ramUsageGet
+ * Purpose:		Measures the current RAM usage
+ * Arguments:	usage		Pointer to the report
+ * Returns:		none
+ * Notes:		Scans the painted area from the end of .bss upwards, which
+ *				takes about 2 clock cycles per free byte
+ * -------------------------------------------------------------------------- */
+
+void ramUsageGet(ramUsage_t * usage)
+{
+	usage->size = RAMEND - RAMSTART + 1;
+	usage->sensor = sensorRamUsage();
+	usage->twiMaster = twiMasterRamUsage();
+	usage->ds1307 = sizeof(ds1307Configuration);
+
+#ifdef HOST_BUILD
+	usage->dataBytes = 0;
+	usage->bssBytes = 0;
+	usage->stackPeak = 0;
+	usage->stackNow = 0;
+	usage->headroom = 0;
+	usage->others = 0;
+#else
+	const uint8_t * p = &__bss_end;
+
+	while((p <= &__stack) && (*p == RAM_USAGE_PAINT))
+		p++;
+	usage->dataBytes = &__data_end - &__data_start;
+	usage->bssBytes = &__bss_end - &__bss_start;
+	usage->stackPeak = &__stack - p + 1;
+	usage->stackNow = RAMEND - SP;
+	usage->headroom = p - &__bss_end;
+	usage->others = usage->dataBytes + usage->bssBytes - usage->sensor - usage->twiMaster - usage->ds1307;
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	ramUsagePrint
+ * Purpose:		Prints the RAM usage report
+ * Arguments:	none
+ * Returns:		none
+ * Notes:		Uses printf, so the USART must already be bound to stdout
+ * -------------------------------------------------------------------------- */
+
+void ramUsagePrint(void)
+{
+	ramUsage_t usage;
+	char buffer[RAM_USAGE_LINE];
+	uint8_t line;
+
+	ramUsageGet(&usage);
+	for(line = 0; ramUsageLine(&usage, line, buffer); line++){
+		if(buffer[0])
+			printf_P(PSTR("%s\n\r"), buffer);
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	ramUsageDump
+ * Purpose:		Appends the RAM usage report to a file
+ * Arguments:	path		File name
+ * Returns:		FatFs result code
+ * Notes:		The volume must be mounted. The FIL object lives on the stack
+ *				during the call, so the dump itself shows in the stack peak
+ * -------------------------------------------------------------------------- */
+
+FRESULT ramUsageDump(const TCHAR * path)
+{
+	ramUsage_t usage;
+	char buffer[RAM_USAGE_LINE];
+	uint8_t line;
+	FRESULT result;
+	FIL file;
+
+	ramUsageGet(&usage);
+	result = f_open(&file, path, FA_WRITE | FA_OPEN_ALWAYS);
+	if(result != FR_OK)
+		return result;
+	result = f_lseek(&file, f_size(&file));
+	for(line = 0; (result == FR_OK) && ramUsageLine(&usage, line, buffer); line++){
+		if(buffer[0] && (f_printf(&file, "%s\n", buffer) == EOF))
+			result = FR_DISK_ERR;
+	}
+	if(f_close(&file) != FR_OK)
+		result = FR_DISK_ERR;
+	return result;
+}
+
+#endif
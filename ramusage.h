@@ -0,0 +1,68 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			ramusage.h
+ * Module:			RAM usage report
+ * Purpose:			Paints the free SRAM at reset and reports the static usage
+ *					(.data/.bss, per module) and the deepest stack excursion
+ *					over the USART or into a file on the SD card
+ * Notes:			Compiled in only when RAM_USAGE is defined; otherwise every
+ *					call below expands to nothing. The area between the end of
+ *					.bss and RAMEND is filled with RAM_USAGE_PAINT in .init1,
+ *					before the C runtime runs, and the stack peak is the lowest
+ *					address whose paint was overwritten. There is no heap
+ *					(printf and FatFs do not call malloc), so everything above
+ *					.bss belongs to the stack. The host build has no AVR data
+ *					space: it reports the module table only
+ * -------------------------------------------------------------------------- */
+
+#ifndef __RAMUSAGE_H
+#define __RAMUSAGE_H 10
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include <stdint.h>
+#include "ff.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define RAM_USAGE_PAINT				0xC5
+
+#ifndef RAM_USAGE_PERIOD
+	#define RAM_USAGE_PERIOD		360		// Records between reports (1 hour)
+#endif
+
+#ifndef RAM_USAGE_FILE
+	#define RAM_USAGE_FILE			"Memoria.txt"
+#endif
+
+// -----------------------------------------------------------------------------
+// New data types --------------------------------------------------------------
+
+typedef struct ramUsage_t{
+	uint16_t	size;					// SRAM size
+	uint16_t	dataBytes;				// Initialized variables (.data)
+	uint16_t	bssBytes;				// Zeroed variables (.bss)
+	uint16_t	stackPeak;				// Deepest stack excursion since reset
+	uint16_t	stackNow;				// Stack in use at the call
+	uint16_t	headroom;				// Bytes never touched since reset
+	uint16_t	sensor;					// sensor.c globals and dados_t
+	uint16_t	twiMaster;				// twimaster.c buffer and state
+	uint16_t	ds1307;					// ds1307Configuration
+	uint16_t	others;					// FatFs, mmc.c, libc (stdio streams)
+} ramUsage_t;
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+#ifdef RAM_USAGE
+	void	ramUsageGet(ramUsage_t * usage);
+	void	ramUsagePrint(void);
+	FRESULT	ramUsageDump(const TCHAR * path);
+#else
+	#define ramUsagePrint()
+	#define ramUsageDump(path)		FR_OK
+#endif
+
+#endif
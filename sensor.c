@@ -9,6 +9,7 @@
 #include <util/delay.h>
 #include "lib/avr_adc.h"
 #include "ds1307.h"
+#include "isrtrace.h"
 
 
 volatile uint16_t valor_adc = 0;
@@ -51,6 +52,7 @@ void adcEtimer_init(){
 
 ISR(ADC_vect)
 {
+	ISR_TRACE_ENTER();
 	uint16_t valor_adc = 0;
 		static uint8_t i_adc0=0;
 		static uint8_t i_adc1=0;
@@ -83,17 +85,30 @@ ISR(ADC_vect)
 
 		GPIO_CplBit(GPIO_B, 1);
 		CPL_BIT(ADCS->AD_MUX, 0);
+	ISR_TRACE_EXIT(ISR_TRACE_ADC);
 }
 
 /* Quando habilitado IRQ de overflow no timer 0*/
 ISR(TIMER0_OVF_vect){
+	ISR_TRACE_ENTER();
 	GPIO_CplBit(GPIO_B, 0);
+	ISR_TRACE_EXIT(ISR_TRACE_TIMER0_OVF);
 }
 
 
 volatile uint16_t get_flag(){
 	return flag;
 }
+
+#ifdef RAM_USAGE
+/* RAM estatica do modulo (globais acima e dados_t), medida nos proprios
+ * objetos para o relatorio do ramusage.c; as estaticas da ADC_vect ficam
+ * em "others" */
+uint16_t sensorRamUsage(){
+	return sizeof(valor_adc) + sizeof(i) + sizeof(sum) + sizeof(n) + sizeof(flag) + sizeof(sen_hall) +
+		sizeof(x) + sizeof(sum_ADC0) + sizeof(sum_ADC1) + sizeof(ADC0) + sizeof(ADC1) + sizeof(dados_t);
+}
+#endif
 /*
 void sensor_handler(){
 	uint16_t soma=0,potencia=0,tensao=0,corrente,conversao_adc_tensao;
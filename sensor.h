@@ -5,6 +5,9 @@
 #include "ds1307.h"
 void adcEtimer_init();
 volatile uint16_t get_flag();
+#ifdef RAM_USAGE
+uint16_t sensorRamUsage();
+#endif
 //void sensor_handler();
 void hardware_init();
 
@@ -0,0 +1,91 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			softuart.c
+ * Module:			Software UART transmitter
+ * Purpose:			Debug console on a GPIO pin for builds in which USART0
+ *					drives the SD card (SD_USART_SPI)
+ * -------------------------------------------------------------------------- */
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "softuart.h"
+#if __SOFTUART_H != 10
+	#error Error 101 - Version mismatch on header and source code files (softUart).
+#endif
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#define SOFTUART_BIT_US			(1000000.0 / SOFTUART_BAUD)
+
+// -----------------------------------------------------------------------------
+// Private function definitions ------------------------------------------------
+
+static int softUartTransmitStd(char data, FILE * stream)
+{
+	softUartTransmit(data);
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Global variables ------------------------------------------------------------
+
+static FILE softUartStream = FDEV_SETUP_STREAM(softUartTransmitStd, NULL, _FDEV_SETUP_WRITE);
+
+// -----------------------------------------------------------------------------
+// Public function definitions -------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ * Function:	softUartInit
+ * Purpose:		Configures the transmit pin as an output at the idle level
+ * Arguments:	none
+ * Returns:		none
+ * -------------------------------------------------------------------------- */
+
+void softUartInit(void)
+{
+	setBit(PORTD, SOFTUART_PIN);
+	setBit(DDRD, SOFTUART_PIN);
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	softUartTransmit
+ * Purpose:		Sends one 8N1 frame
+ * Arguments:	data		Byte to be sent
+ * Returns:		none
+ * Notes:		Interrupts are disabled during the frame
+ * -------------------------------------------------------------------------- */
+
+void softUartTransmit(char data)
+{
+	uint8_t sreg = SREG;
+	uint8_t i;
+
+	cli();
+	clrBit(PORTD, SOFTUART_PIN);		// Start bit
+	_delay_us(SOFTUART_BIT_US);
+	for(i = 0; i < 8; i++){
+		if(data & 0x01)
+			setBit(PORTD, SOFTUART_PIN);
+		else
+			clrBit(PORTD, SOFTUART_PIN);
+		data >>= 1;
+		_delay_us(SOFTUART_BIT_US);
+	}
+	setBit(PORTD, SOFTUART_PIN);		// Stop bit
+	_delay_us(SOFTUART_BIT_US);
+	SREG = sreg;
+}
+
+/* -----------------------------------------------------------------------------
+ * Function:	softUartStdio
+ * Purpose:		Binds stdout and stderr to the software UART
+ * Arguments:	none
+ * Returns:		none
+ * -------------------------------------------------------------------------- */
+
+void softUartStdio(void)
+{
+	stdout = stderr = &softUartStream;
+}
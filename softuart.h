@@ -0,0 +1,40 @@
+/* -----------------------------------------------------------------------------
+ * Project:			Sensor de Radiacao
+ * File:			softuart.h
+ * Module:			Software UART transmitter
+ * Purpose:			Debug console on a GPIO pin for builds in which USART0
+ *					drives the SD card (SD_USART_SPI)
+ * Notes:			Transmit only, 8N1, timed with _delay_us with interrupts
+ *					disabled during each frame (about 1 ms per character at
+ *					9600 bps, which delays the ADC and TWI interrupts by up to
+ *					one frame). Wire SOFTUART_PIN to the RX line of the
+ *					USB-serial adapter
+ * -------------------------------------------------------------------------- */
+
+#ifndef __SOFTUART_H
+#define __SOFTUART_H 10
+
+// -----------------------------------------------------------------------------
+// Header files ----------------------------------------------------------------
+
+#include "globalDefines.h"
+
+// -----------------------------------------------------------------------------
+// Constant definitions --------------------------------------------------------
+
+#ifndef SOFTUART_PIN
+	#define SOFTUART_PIN		PD3
+#endif
+
+#ifndef SOFTUART_BAUD
+	#define SOFTUART_BAUD		9600UL
+#endif
+
+// -----------------------------------------------------------------------------
+// Public functions declaration ------------------------------------------------
+
+void	softUartInit(void);
+void	softUartTransmit(char data);
+void	softUartStdio(void);
+
+#endif
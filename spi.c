@@ -1,11 +1,16 @@
 #include "spi.h"
 
+//Com SD_USART_SPI o cartao fica na USART0 em modo SPI mestre (usartspi.c) e
+//so o benchmark abaixo e compilado aqui
+#ifndef SD_USART_SPI
+
 //Inicializa a SPI
 void SPI_Init(void)
 {
 	//PORTB = 0xFF;
 	DDRB = (1<<PB2) | (1<<PB3) | (1<<PB5);
-	SPCR = (1<<SPE) | (1<<MSTR) | (1<<SPI2X)| (1<<SPR1) | (1<<SPR0);
+	SPCR = (1<<SPE) | (1<<MSTR) | (1<<SPR1) | (1<<SPR0);	//SPI2X fica no SPSR
+	SPSR = 0;
 }
 
 //Envia e recebe um byte via SPI
@@ -27,3 +32,152 @@ char SPI_ReceiveByte(void)
 {
 	return SPI_SendReceiveByte(0xFF);
 }
+
+//Envia um bloco via SPI e ignora o que recebe
+//O proximo byte e carregado e o laco e contado enquanto o byte atual e
+//deslocado, e SPDR e escrito assim que SPIF sobe: sem chamada de funcao
+//entre dois bytes no barramento
+void SPI_SendBlock(const uint8_t * data, uint16_t count)
+{
+	uint8_t next;
+
+	SPDR = *data++;
+	while(--count){
+		next = *data++;
+		while(!(SPSR & (1<<SPIF)));
+		SPDR = next;
+	}
+	while(!(SPSR & (1<<SPIF)));
+	(void)SPDR;							//Limpa SPIF
+}
+
+//Recebe um bloco via SPI enviando bytes "dummy"
+//O byte recebido e lido e o proximo "dummy" e enviado antes de guardar o
+//byte na memoria, que acontece durante o deslocamento seguinte
+void SPI_ReceiveBlock(uint8_t * data, uint16_t count)
+{
+	uint8_t received;
+
+	SPDR = 0xFF;
+	while(--count){
+		while(!(SPSR & (1<<SPIF)));
+		received = SPDR;
+		SPDR = 0xFF;
+		*data++ = received;
+	}
+	while(!(SPSR & (1<<SPIF)));
+	*data = SPDR;
+}
+
+//Relogio lento para a inicializacao do cartao (F_CPU/128, ate 400 kHz)
+void SPI_SetClockSlow(void)
+{
+	SPI_SetClockDivider(128);
+}
+
+//Relogio rapido apos a inicializacao do cartao (F_CPU/4)
+void SPI_SetClockFast(void)
+{
+	SPI_SetClockDivider(4);
+}
+
+//Menor divisor suportado (2, 4, ..., 128) que nao seja menor que divider
+//Divisor = 2 << rate: SPR1:SPR0 = rate/2 e SPI2X nos valores pares, exceto
+//128, que e SPR1:SPR0 = 3 sem SPI2X
+void SPI_SetClockDivider(uint8_t divider)
+{
+	uint8_t rate = 0;
+
+	while((rate < 6) && ((2 << rate) < divider))
+		rate++;
+	if(rate == 6){
+		SPCR |= (1<<SPR1) | (1<<SPR0);
+		SPSR = 0;
+	}else{
+		SPCR = (SPCR & ~((1<<SPR1) | (1<<SPR0))) | ((rate >> 1) << SPR0);
+		SPSR = (rate & 1) ? 0 : (1<<SPI2X);
+	}
+}
+
+//Divisor de F_CPU do relogio atual (0: SPI desabilitada)
+uint8_t SPI_ClockDivider(void)
+{
+	uint8_t divider;
+
+	if(!(SPCR & (1<<SPE)))
+		return 0;
+	divider = (SPCR & (1<<SPR1)) ? ((SPCR & (1<<SPR0)) ? 128 : 64) : ((SPCR & (1<<SPR0)) ? 16 : 4);
+	if(SPSR & (1<<SPI2X))
+		divider /= 2;
+	return divider;
+}
+
+#endif
+
+#ifdef SPI_BENCH
+//Cada parte de SPI_BENCH_BUFFER bytes e medida sozinha com o Timer1 a F_CPU/8:
+//a F_CPU/128 sao 128 ciclos por byte, e 512 bytes (65536 ciclos ou mais) nao
+//cabem no TCNT1. Ate 256 bytes a parte fica abaixo de 65536 contagens
+#if SPI_BENCH_BUFFER > 256
+	#error SPI_BENCH_BUFFER must not exceed 256
+#endif
+
+//Mede com o Timer1 os ciclos gastos para mover 512 bytes com o laco de um
+//byte por chamada (SPI_SendByte/SPI_ReceiveByte) e com as funcoes de bloco,
+//com resolucao de 8 ciclos. Deve ser chamada com o cartao desselecionado (CS
+//alto), pois envia bytes quaisquer, e usa o Timer1: chamar depois de
+//bootProfileReport() e antes de isrTraceStart()
+static uint32_t SPI_BenchRun(uint8_t method, uint8_t * buffer)
+{
+	uint32_t ticks = 0;
+	uint16_t start, i, j;
+	uint8_t sreg = SREG;
+
+	cli();
+	for(i = 0; i < 512 / SPI_BENCH_BUFFER; i++){
+		start = TCNT1;
+		switch(method){
+		case 0:
+			for(j = 0; j < SPI_BENCH_BUFFER; j++)
+				SPI_SendByte(buffer[j]);
+			break;
+		case 1:
+			SPI_SendBlock(buffer, SPI_BENCH_BUFFER);
+			break;
+		case 2:
+			for(j = 0; j < SPI_BENCH_BUFFER; j++)
+				buffer[j] = SPI_ReceiveByte();
+			break;
+		default:
+			SPI_ReceiveBlock(buffer, SPI_BENCH_BUFFER);
+			break;
+		}
+		ticks += (uint16_t)(TCNT1 - start);
+	}
+	SREG = sreg;
+	return ticks * 8;
+}
+
+void SPI_Benchmark(void)
+{
+	uint8_t buffer[SPI_BENCH_BUFFER];
+	uint32_t cycles[4];
+	uint8_t i;
+
+	if(!SPI_ClockDivider()){				//SPI ainda nao inicializada (sem cartao)
+		SPI_Init();
+		SPI_SetClockFast();				//Como o cartao apos disk_initialize
+	}
+	for(i = 0; i < SPI_BENCH_BUFFER; i++)
+		buffer[i] = i;
+	TCCR1A = 0;
+	TCCR1B = (1<<CS11);					//F_CPU/8
+	for(i = 0; i < 4; i++)
+		cycles[i] = SPI_BenchRun(i, buffer);
+	TCCR1B = 0;
+
+	printf("SPI bench (ciclos por 512 bytes, minimo %lu):\n\r", 512UL * 8 * SPI_ClockDivider());
+	printf("  envio    laco %lu bloco %lu\n\r", (unsigned long)cycles[0], (unsigned long)cycles[1]);
+	printf("  recepcao laco %lu bloco %lu\n\r", (unsigned long)cycles[2], (unsigned long)cycles[3]);
+}
+#endif
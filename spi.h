@@ -1,6 +1,9 @@
 #ifndef SPI_H
 #define SPI_H
 
+//Interface com o cartao SD. Implementada pelo periferico SPI (spi.c) ou, com
+//SD_USART_SPI definido, pela USART0 em modo SPI mestre (usartspi.c)
+
 #include "globalDefines.h"
 #include <avr/io.h>
 
@@ -16,4 +19,29 @@ void SPI_SendByte(char data);
 //Envia um byte "dummy" via SPI e retorna o que recebeu
 char SPI_ReceiveByte(void);
 
+//Envia um bloco via SPI e ignora o que recebe (count >= 1)
+void SPI_SendBlock(const uint8_t * data, uint16_t count);
+
+//Recebe um bloco via SPI enviando bytes "dummy" (count >= 1)
+void SPI_ReceiveBlock(uint8_t * data, uint16_t count);
+
+//Relogio lento (inicializacao do cartao) e rapido
+void SPI_SetClockSlow(void);
+void SPI_SetClockFast(void);
+
+//Menor divisor de F_CPU suportado que nao seja menor que divider
+void SPI_SetClockDivider(uint8_t divider);
+
+//Divisor de F_CPU do relogio atual (0: desabilitada)
+uint8_t SPI_ClockDivider(void);
+
+#ifdef SPI_BENCH
+#ifndef SPI_BENCH_BUFFER
+	#define SPI_BENCH_BUFFER	128
+#endif
+
+//Compara os lacos de um byte com as funcoes de bloco (ciclos por 512 bytes)
+void SPI_Benchmark(void);
+#endif
+
 #endif
@@ -20,6 +20,7 @@
 #if __TWIMASTER_H != 20
 	#error Error 101 - Version mismatch on header and source code files (twiMaster).
 #endif
+#include "isrtrace.h"
 
 // -----------------------------------------------------------------------------
 // Global variables ------------------------------------------------------------
@@ -203,6 +204,21 @@ twiState_t twiMasterGetStatus(void)
 	return twiState;
 }
 
+#ifdef RAM_USAGE
+/* -----------------------------------------------------------------------------
+ * Function:	twiMasterRamUsage
+ * Purpose:		Returns the static RAM of the module (ramUsage report)
+ * Arguments:	none
+ * Returns:		Bytes of the global variables above
+ * Notes:		The static variable of TWI_vect is counted as "others"
+ * -------------------------------------------------------------------------- */
+
+uint16 twiMasterRamUsage(void)
+{
+	return sizeof(twiBufferData) + sizeof(twiBufferSize) + sizeof(twiState) + sizeof(twiStatus);
+}
+#endif
+
 // -----------------------------------------------------------------------------
 // Interruption handlers -------------------------------------------------------
 
@@ -214,6 +230,7 @@ twiState_t twiMasterGetStatus(void)
 ISR(TWI_vect)
 {
 	static uint8 twiBufferPointer;
+	ISR_TRACE_ENTER();
 
 	switch(TWSR & 0xFC){
 	case TWI_START:			// START has been transmitted
@@ -254,4 +271,5 @@ ISR(TWI_vect)
 		TWCR = (1 << TWEN);		// Reset TWI Interface
 		break;
 	}
+	ISR_TRACE_EXIT(ISR_TRACE_TWI);
 }
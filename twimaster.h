@@ -106,6 +106,9 @@ twiResult_t	twiMasterSendData(uint8 deviceAddress, uint8 readWrite, uint8 *messa
 bool_t		twiMasterReadFromBuffer(uint8 *message, uint8 messageSize);
 twiResult_t	twiMasterResendData(void);
 twiState_t	twiMasterErrorHandler(twiState_t twiErrorCode);
+#ifdef RAM_USAGE
+uint16		twiMasterRamUsage(void);
+#endif
 
 // -----------------------------------------------------------------------------
 // Private functions declaration - do not use outside this module --------------
@@ -0,0 +1,115 @@
+#include "spi.h"
+
+//Cartao SD na USART0 em modo SPI mestre (MSPIM), selecionado com SD_USART_SPI
+//Ligacoes: XCK0 (PD4) -> SCK, TXD0 (PD1) -> MOSI, RXD0 (PD0) <- MISO, CS em PB2
+//O transmissor da USART tem buffer duplo: um byte pode ser escrito em UDR0
+//enquanto o anterior e deslocado, e os bytes saem sem intervalo no barramento.
+//A USART deixa de servir o console, que passa para a UART por software
+//(softuart.c)
+#ifdef SD_USART_SPI
+
+#define USPI_UBRR_SLOW	63				//F_CPU/128
+#define USPI_UBRR_FAST	0				//F_CPU/2
+
+//Inicializa a USART0 em modo SPI mestre (modo 0, MSB primeiro)
+void SPI_Init(void)
+{
+	DDRB |= (1<<PB2);					//CS
+	DDRD |= (1<<PD4) | (1<<PD1);		//XCK0 e TXD0
+	UBRR0 = 0;							//Exigido antes de habilitar o transmissor
+	UCSR0C = (1<<UMSEL01) | (1<<UMSEL00);
+	UCSR0B = (1<<RXEN0) | (1<<TXEN0);
+	UBRR0 = USPI_UBRR_SLOW;
+}
+
+//Envia e recebe um byte via SPI
+char SPI_SendReceiveByte(char data)
+{
+	UDR0 = data;
+	while(!(UCSR0A & (1<<RXC0)));
+	return UDR0;
+}
+
+//Envia um byte via SPI e ignora o que recebe
+void SPI_SendByte(char data)
+{
+	SPI_SendReceiveByte(data);
+}
+
+//Envia um byte "dummy" via SPI e retorna o que recebeu
+char SPI_ReceiveByte(void)
+{
+	return SPI_SendReceiveByte(0xFF);
+}
+
+//Envia um bloco via SPI e ignora o que recebe
+//O proximo byte vai para o buffer de transmissao enquanto o atual e
+//deslocado; cada byte recebido e lido para nao perder o sincronismo
+void SPI_SendBlock(const uint8_t * data, uint16_t count)
+{
+	uint8_t next;
+
+	UDR0 = *data++;
+	while(--count){
+		next = *data++;
+		while(!(UCSR0A & (1<<UDRE0)));
+		UDR0 = next;
+		while(!(UCSR0A & (1<<RXC0)));	//Byte anterior terminou
+		(void)UDR0;
+	}
+	while(!(UCSR0A & (1<<RXC0)));
+	(void)UDR0;
+}
+
+//Recebe um bloco via SPI enviando bytes "dummy"
+//Dois bytes ficam sempre em transito: o "dummy" seguinte e escrito assim que
+//um byte e lido, antes de guarda-lo na memoria
+void SPI_ReceiveBlock(uint8_t * data, uint16_t count)
+{
+	uint8_t received;
+
+	UDR0 = 0xFF;
+	if(count > 1){
+		while(!(UCSR0A & (1<<UDRE0)));
+		UDR0 = 0xFF;
+	}
+	while(count > 2){
+		while(!(UCSR0A & (1<<RXC0)));
+		received = UDR0;
+		UDR0 = 0xFF;					//O buffer esvaziou quando o byte chegou
+		*data++ = received;
+		count--;
+	}
+	while(count--){
+		while(!(UCSR0A & (1<<RXC0)));
+		*data++ = UDR0;
+	}
+}
+
+//Relogio lento para a inicializacao do cartao (F_CPU/128, ate 400 kHz)
+void SPI_SetClockSlow(void)
+{
+	UBRR0 = USPI_UBRR_SLOW;
+}
+
+//Relogio rapido apos a inicializacao do cartao (F_CPU/2)
+void SPI_SetClockFast(void)
+{
+	UBRR0 = USPI_UBRR_FAST;
+}
+
+//Menor divisor par que nao seja menor que divider (F_CPU/(2*(UBRR0+1)))
+void SPI_SetClockDivider(uint8_t divider)
+{
+	UBRR0 = (divider > 2) ? ((divider + 1) / 2 - 1) : 0;
+}
+
+//Divisor de F_CPU do relogio atual (0: USART fora do modo SPI mestre)
+uint8_t SPI_ClockDivider(void)
+{
+	if(!(UCSR0B & (1<<TXEN0)) || ((UCSR0C & ((1<<UMSEL01) | (1<<UMSEL00))) != ((1<<UMSEL01) | (1<<UMSEL00))))
+		return 0;
+	return 2 * (UBRR0 + 1);
+}
+
+#endif